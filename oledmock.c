@@ -0,0 +1,175 @@
+//
+// Mock display transport for testing shapes96 without hardware
+//
+// Copyright 2017 BitBank Software, Inc. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===========================================================================
+
+// Only what the library sends is decoded: addressing, position, window,
+// start line, multiplex ratio and scroll commands move the state, the rest
+// (contrast, COM pins, charge pump...) are parsed for their length and
+// ignored.
+// A hardware scroll moves the scrolled pages iScrollSteps columns when
+// it is stopped, the vertical offset of a diagonal one is not modelled.
+
+#include <string.h>
+#include "oledmock.h"
+
+void oledMockClearStats(OLEDMOCK *pMock) {
+	pMock->iTransactions = pMock->iMessages = 0;
+	pMock->lCmdBytes = pMock->lDataBytes = pMock->lScrollData = 0;
+}
+
+void oledMockReset(OLEDMOCK *pMock) {
+	memset(pMock, 0, sizeof(OLEDMOCK));
+	pMock->iAddrMode = 2; // page mode after reset
+	pMock->iMux = 63;
+	pMock->iColEnd = 127;
+	pMock->iPageEnd = 7;
+}
+
+// Number of argument bytes that follow a command
+static int oledMockArgCount(unsigned char c) {
+	switch (c) {
+		case 0x20: case 0x81: case 0x8d: case 0xa8: case 0xd3:
+		case 0xd5: case 0xd9: case 0xda: case 0xdb:
+			return 1;
+		case 0x21: case 0x22: case 0xa3:
+			return 2;
+		case 0x29: case 0x2a:
+			return 5;
+		case 0x26: case 0x27:
+			return 6;
+	}
+	return 0;
+}
+
+// Move the scrolled pages by the columns the scroll has run for, as the
+// controller does to its memory while a scroll is active
+static void oledMockScroll(OLEDMOCK *pMock) {
+	unsigned char ucPage[128];
+	int y, x, iShift;
+
+	iShift = pMock->iScrollSteps & 127;
+	if (pMock->iScrollCmd == 0x27 || pMock->iScrollCmd == 0x2a)
+		iShift = (128 - iShift) & 127; // to the left
+	for (y=pMock->iScrollP0; y<=pMock->iScrollP1; y++) {
+		for (x=0; x<128; x++)
+			ucPage[(x + iShift) & 127] = pMock->ucRAM[y][x];
+		memcpy(pMock->ucRAM[y], ucPage, 128);
+	}
+}
+
+static void oledMockCommand(OLEDMOCK *pMock, unsigned char c) {
+	if (pMock->iPending) {	// argument of the last command
+		pMock->ucArgs[pMock->iArgs++] = c;
+		if (pMock->iArgs < pMock->iPending)
+			return;
+		pMock->iPending = 0;
+		if (pMock->iCmd == 0x20) {
+			pMock->iAddrMode = pMock->ucArgs[0] & 3;
+		} else if (pMock->iCmd == 0xa8) {
+			pMock->iMux = pMock->ucArgs[0] & 0x3f;
+		} else if (pMock->iCmd == 0x21) {
+			pMock->iColStart = pMock->iCol = pMock->ucArgs[0] & 0x7f;
+			pMock->iColEnd = pMock->ucArgs[1] & 0x7f;
+		} else if (pMock->iCmd == 0x22) {
+			pMock->iPageStart = pMock->iPage = pMock->ucArgs[0] & 7;
+			pMock->iPageEnd = pMock->ucArgs[1] & 7;
+		} else if (pMock->iCmd >= 0x26 && pMock->iCmd <= 0x2a) {
+			pMock->iScrollCmd = pMock->iCmd;
+			pMock->iScrollP0 = pMock->ucArgs[1] & 7;
+			pMock->iScrollP1 = pMock->ucArgs[3] & 7;
+		}
+		return;
+	}
+	if ((pMock->iPending = oledMockArgCount(c)) != 0) {
+		pMock->iCmd = c;
+		pMock->iArgs = 0;
+	} else if (c < 0x10) {
+		pMock->iCol = (pMock->iCol & 0xf0) | c;
+	} else if (c < 0x20) {
+		pMock->iCol = (pMock->iCol & 0x0f) | ((c & 0xf) << 4);
+	} else if (c == 0x2e) {
+		if (pMock->bScrolling)
+			oledMockScroll(pMock);
+		pMock->bScrolling = 0;
+	} else if (c == 0x2f) {
+		pMock->bScrolling = 1;
+	} else if (c >= 0x40 && c <= 0x7f) {
+		pMock->iStartLine = c & 0x3f;
+	} else if (c >= 0xb0 && c <= 0xb7) {
+		pMock->iPage = c & 7;
+	}
+}
+
+// Store a data byte and advance the pointer like the addressing mode does
+static void oledMockData(OLEDMOCK *pMock, unsigned char d) {
+	if (pMock->iCol < 132)
+		pMock->ucRAM[pMock->iPage][pMock->iCol] = d;
+	if (pMock->iAddrMode == 2) {	// page: the column advances and wraps
+		if (++pMock->iCol >= 132)
+			pMock->iCol = 0;
+	} else if (pMock->iAddrMode == 0) {	// horizontal: across the window, then down
+		if (++pMock->iCol > pMock->iColEnd) {
+			pMock->iCol = pMock->iColStart;
+			if (++pMock->iPage > pMock->iPageEnd)
+				pMock->iPage = pMock->iPageStart;
+		}
+	} else {	// vertical: down the window, then across
+		if (++pMock->iPage > pMock->iPageEnd) {
+			pMock->iPage = pMock->iPageStart;
+			if (++pMock->iCol > pMock->iColEnd)
+				pMock->iCol = pMock->iColStart;
+		}
+	}
+}
+
+int oledMockTransfer(void *pUser, OLEDMSG *pMsgs, int iCount) {
+	OLEDMOCK *pMock = pUser;
+	int i, j;
+
+	if (pMock->iFail > 0) {	// lost on the bus
+		pMock->iFail--;
+		return -1;
+	}
+	pMock->iTransactions++;
+	for (i=0; i<iCount; i++) {
+		pMock->iMessages++;
+		for (j=1; j<pMsgs[i].iLen; j++) {
+			if (pMsgs[i].pData[0] == 0x00) {
+				oledMockCommand(pMock, pMsgs[i].pData[j]);
+				pMock->lCmdBytes++;
+			} else {
+				oledMockData(pMock, pMsgs[i].pData[j]);
+				pMock->lDataBytes++;
+				if (pMock->bScrolling) // not allowed by the SSD1306
+					pMock->lScrollData++;
+			}
+		}
+	}
+	return 0;
+}
+
+int oledMockPixel(OLEDMOCK *pMock, int iType, int x, int y) {
+	int iRow;
+
+	if (iType == OLED_64x32) {	// the middle of display memory
+		x += 32;
+		y += 32;
+	} else if (iType == OLED_132x64) {
+		x += 2;
+	}
+	if (y > pMock->iMux) // COM lines past the multiplex ratio stay dark
+		return 0;
+	iRow = (y + pMock->iStartLine) & 63;
+	return (pMock->ucRAM[iRow >> 3][x] >> (iRow & 7)) & 1;
+}
@@ -0,0 +1,56 @@
+//
+// Mock display transport for testing shapes96 without hardware
+//
+// Copyright 2017 BitBank Software, Inc. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//===========================================================================
+#ifndef OLEDMOCK_H
+#define OLEDMOCK_H
+
+#include "shapes96.h"
+
+// A pretend SSD1306/SH1106: install oledMockTransfer() with
+// oledSetTransport(pfn, &mock) and every transaction is counted and
+// decoded into the mock's display memory, as a controller would
+typedef struct
+{
+   unsigned char ucRAM[8][132]; // display memory, page-major
+   int iAddrMode;               // 0 = horizontal, 1 = vertical, 2 = page
+   int iPage, iCol;             // write pointer
+   int iColStart, iColEnd, iPageStart, iPageEnd; // window (0x21/0x22)
+   int iStartLine;              // 0x40-0x7f
+   int iMux;                    // multiplex ratio (0xa8): rows shown - 1
+   int bScrolling;              // between 0x2f and 0x2e
+   int iScrollCmd, iScrollP0, iScrollP1; // last 0x26/0x27/0x29/0x2a set up
+   int iScrollSteps;            // columns a scroll moves before it is stopped
+   int iPending, iCmd, iArgs;   // multi-byte command being parsed
+   unsigned char ucArgs[8];
+   // What arrived
+   int iTransactions, iMessages;
+   long lCmdBytes, lDataBytes;
+   long lScrollData;            // data bytes written during a hardware scroll
+   int iFail;                   // fail this many of the next transactions
+} OLEDMOCK;
+
+// Power-on state: memory cleared, page mode, counters zeroed
+void oledMockReset(OLEDMOCK *pMock);
+
+// Zero the counters only
+void oledMockClearStats(OLEDMOCK *pMock);
+
+// The transport to pass to oledSetTransport(); pUser is the OLEDMOCK
+int oledMockTransfer(void *pUser, OLEDMSG *pMsgs, int iCount);
+
+// The pixel the panel shows at (x,y) for a display type (not flipped),
+// taking the start line and the visible part of display memory into account
+int oledMockPixel(OLEDMOCK *pMock, int iType, int x, int y);
+
+#endif // OLEDMOCK_H
@@ -17,7 +17,9 @@
 //===========================================================================
 
 // The I2C writes (through a file handle) can be single or multiple bytes.
-// The write mode stays in effect throughout each call to write()
+// The write mode stays in effect throughout each I2C message.
+// Messages are gathered into a transaction and handed to the kernel with a
+// single I2C_RDWR ioctl (or to a user supplied transport for testing).
 // To write commands to the OLED controller, start a byte sequence with 0x00,
 // to write data, start a byte sequence with 0x40,
 // The OLED controller is set to "page mode". This divides the display
@@ -34,29 +36,186 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <math.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include "shapes96.h"
 
-int _width = 0;
-int _height = 0;
-
 extern unsigned char ucFont[], ucSmallFont[];
-static int iScreenOffset; // current write offset of screen data
-static unsigned char ucScreen[1024]; // local copy of the image buffer
-static int file_i2c = 0;
-static int oled_type, oled_flip;
 
-static void oledWriteCommand(unsigned char);
+#define OLED_MAX_MSGS 32 // the kernel accepts up to 42 per I2C_RDWR call
+#define OLED_XFER_SIZE 2048
+
+// One I2C bus
+// Transactions of all the displays on a bus are serialized by mtxBus, and
+// a worker thread flushes the bus's share of each oledFlushMany() call
+#define OLED_MAX_BUSES 16 // buses are indexed by channel modulo this
+typedef struct {
+	oled_t **ppOLED; // displays to flush, all on this bus
+	int iCount;
+	int iError; // -1 if any of them failed
+	int bDone;
+} OLEDJOB;
+
+typedef struct {
+	pthread_mutex_t mtxBus; // held for each transaction on the bus
+	pthread_mutex_t mtxJob;
+	pthread_cond_t cvJob;
+	OLEDJOB *pJob; // job handed to the worker, NULL when it is free
+	int bWorker; // worker thread started
+} OLEDBUS;
+
+static OLEDBUS oledBuses[OLED_MAX_BUSES];
+static pthread_once_t onceBuses = PTHREAD_ONCE_INIT;
+
+// Everything needed to drive one display
+// A sprite: a masked bitmap composited over ucScreen
+// The pixels it covers are kept in ucSave and put back when it moves
+#define OLED_MAX_SPRITES 8
+#define OLED_SPRITE_SIZE 32 // largest width and height
+typedef struct {
+	int w, h; // 0 until a bitmap is set
+	int x, y, bVisible;
+	int iSaveX0, iSaveY0, iSaveX1, iSaveY1; // box saved in ucSave (on screen)
+	unsigned char ucImage[OLED_SPRITE_SIZE*4]; // bitmap & mask, page-major
+	unsigned char ucHole[OLED_SPRITE_SIZE*4]; // inverted mask
+	unsigned char ucSave[OLED_SPRITE_SIZE*5]; // the pages under it
+} OLEDSPRITE;
+
+struct oled_t {
+	int iWidth, iHeight;
+	int iScreenOffset; // current write offset of screen data
+	unsigned char *ucScreen; // local copy of the image buffer
+	int iPitch, iPages; // bytes per page and pages in ucScreen
+	int file_i2c;
+	OLEDBUS *pBus; // the bus the display is on
+	int iAddr, bRdwr; // slave address, adapter supports I2C_RDWR
+	int bReady; // initialized and able to talk to the display
+	int iType, bFlip;
+	int iAddrMode; // memory addressing mode
+	int iFillRule; // for oledFilledPolygon()
+	int bDeferred; // draw into ucScreen only until oledFlush()
+	int *iDirtyMin, *iDirtyMax; // per-page column range not yet sent
+	// Drawing is clipped to this rectangle (inclusive), the screen by default
+	int iClipX0, iClipY0, iClipX1, iClipY1;
+
+	// Background flush thread
+	// The application draws into ucScreen (the back buffer) while the thread
+	// sends the previously presented frame from ucFront
+	int bAsync; // flush thread is running
+	int bAsyncDeferred; // bDeferred to go back to when it stops
+	pthread_t tidFlush;
+	pthread_mutex_t mtxFlush;
+	pthread_cond_t cvFlush;
+	int bFramePending; // ucFront holds a frame the thread hasn't sent
+	int bFlushQuit; // ask the thread to exit once idle
+	int iFlushError; // result of the last frame sent by the thread
+	unsigned char *ucFront; // copy of the last presented frame
+	int *iFrontMin, *iFrontMax; // its dirty spans
+
+	// Pending I2C transaction
+	OLEDMSG oledMsgs[OLED_MAX_MSGS];
+	int iMsgCount;
+	unsigned char ucXfer[OLED_XFER_SIZE]; // bytes of the queued messages
+	int iXferLen;
+	int bCmdOpen; // last queued message takes more commands
+	// Mirror of the controller's page and column pointer (in display
+	// memory) as of the end of the queued messages, for skipping
+	// position commands it already satisfies
+	int bCursorValid, iCursorPage, iCursorCol;
+	unsigned long ulSkipped; // position command bytes not sent
+	OLEDTRANSPORT pfnTransport; // NULL = I2C_RDWR on file_i2c
+	void *pTransportUser;
+
+	// Video wall: a canvas of iWallCols x iWallRows 128x64 panels
+	oled_t **ppPanels; // NULL for a single display
+	oled_t **ppFlush; // panels with changes, for oledFlushMany()
+	int iWallCols, iWallRows;
+
+	// Hardware scroll running over pages iScrollP0-iScrollP1
+	int bScrolling, iScrollP0, iScrollP1;
+	int bFlushHeld; // a flush came while it ran and is still to be sent
+	// Display start line in pages: page 0 of ucScreen is shown from
+	// display memory page iStartPage; iStartSent is what the display has,
+	// -1 after a failed transfer
+	int iStartPage, iStartSent;
+	// Text console cursor (column in characters, page) and font
+	int iConX, iConY, iConFont;
+
+	// Sprites, drawn in index order (the last one is on top)
+	OLEDSPRITE sprites[OLED_MAX_SPRITES];
+
+	// What the display is showing, for sending only the bytes that differ
+	// Pages are trusted once they have been sent whole (bit y of
+	// iShownValid); NULL on a video wall, whose panels keep their own
+	unsigned char *ucShown;
+	int iShownValid;
+	int bRepaint; // a transfer failed: the next frame sends every page
+
+	// Buffers of a single display
+	unsigned char ucFrames[3][1024];
+	int iSpans[4][8];
+};
+
+// The display used by the functions without a context argument
+static oled_t oledDefault = {
+	.ucScreen = oledDefault.ucFrames[0], .ucFront = oledDefault.ucFrames[1],
+	.ucShown = oledDefault.ucFrames[2],
+	.iPitch = 128, .iPages = 8,
+	.iDirtyMin = oledDefault.iSpans[0], .iDirtyMax = oledDefault.iSpans[1],
+	.iFrontMin = oledDefault.iSpans[2], .iFrontMax = oledDefault.iSpans[3],
+	.iAddrMode = OLED_ADDR_PAGE,
+	.iFillRule = OLED_FILL_EVENODD,
+	.iClipX1 = 127, .iClipY1 = 63,
+	.mtxFlush = PTHREAD_MUTEX_INITIALIZER,
+	.cvFlush = PTHREAD_COND_INITIALIZER
+};
+
+static void oledQueueCommand(oled_t *pOLED, unsigned char);
+static int oledCommit(oled_t *pOLED);
+static void oledWriteCommand(oled_t *pOLED, unsigned char);
+static void oledWriteCommand2(oled_t *pOLED, unsigned char, unsigned char);
+static void oledMarkDirty(oled_t *pOLED, int y, int x0, int x1);
+static void oledClearDirty(oled_t *pOLED);
+static void oledWaitIdle(oled_t *pOLED);
+static int oledSendFrame(oled_t *pOLED, unsigned char *pBuf, int *pMin, int *pMax);
+static int oledUpdate(oled_t *pOLED);
+
+static void oledInitBuses(void) {
+	int i;
+
+	for (i=0; i<OLED_MAX_BUSES; i++) {
+		pthread_mutex_init(&oledBuses[i].mtxBus, NULL);
+		pthread_mutex_init(&oledBuses[i].mtxJob, NULL);
+		pthread_cond_init(&oledBuses[i].cvJob, NULL);
+	}
+}
+
+// Number of visible pages (8 lines each) and columns for the display type
+static int oledPageCount(oled_t *pOLED) {
+	if (pOLED->ppPanels)
+		return pOLED->iPages;
+	return (pOLED->iType == OLED_128x32 || pOLED->iType == OLED_64x32) ? 4:8;
+}
+
+static int oledColumnCount(oled_t *pOLED) {
+	if (pOLED->ppPanels)
+		return pOLED->iPitch;
+	return (pOLED->iType == OLED_64x32) ? 64:128;
+}
+
 //
 // Opens a file system handle to the I2C device
-// Initializes the OLED controller into "page mode"
+// Initializes the OLED controller into "page mode" (or the mode
+// chosen beforehand with oledSetAddressingMode())
 // Prepares the font data for the orientation of the display
 // Returns 0 for success, 1 for failure
 //
-int oledInit(int iChannel, int iAddr, int iType, int bFlip, int bInvert) {
+int oledInitCtx(oled_t *pOLED, int iChannel, int iAddr, int iType, int bFlip, int bInvert) {
 	const unsigned char oled64_initbuf[]={
 		0x00,0xae,0xa8,0x3f,0xd3,0x00,0x40,0xa1,0xc8,
 		0xda,0x12,0x81,0xff,0xa4,0xa6,0xd5,0x80,0x8d,0x14,
@@ -65,237 +224,1710 @@ int oledInit(int iChannel, int iAddr, int iType, int bFlip, int bInvert) {
 		0x00,0xae,0xd5,0x80,0xa8,0x1f,0xd3,0x00,0x40,0x8d,0x14,0xa1,0xc8,0xda,0x02,
 		0x81,0x7f,0xd9,0xf1,0xdb,0x40,0xa4,0xa6,0xaf};
 
+	const unsigned char *pInit;
 	char filename[32];
-	unsigned char uc[4];
-
-	oled_type = iType;
-	oled_flip = bFlip;
-	sprintf(filename, "/dev/i2c-%d", iChannel);
-	if ((file_i2c = open(filename, O_RDWR)) < 0) {
-		fprintf(stderr, "Failed to open i2c bus %d\n", iChannel);
-		file_i2c = 0;
-		return 1;
-	}
+	unsigned long ulFuncs;
+	int i, iInitLen;
+
+	pOLED->iType = iType;
+	pOLED->bFlip = bFlip;
+	pOLED->iAddr = iAddr;
+	pthread_once(&onceBuses, oledInitBuses);
+	pOLED->pBus = &oledBuses[(unsigned)iChannel % OLED_MAX_BUSES];
+	oledClearDirty(pOLED);
+	pOLED->iMsgCount = pOLED->iXferLen = pOLED->bCmdOpen = 0;
+	if (pOLED->pfnTransport == NULL) {	// talk to the I2C bus
+		sprintf(filename, "/dev/i2c-%d", iChannel);
+		if ((pOLED->file_i2c = open(filename, O_RDWR)) < 0) {
+			fprintf(stderr, "Failed to open i2c bus %d\n", iChannel);
+			pOLED->file_i2c = 0;
+			return 1;
+		}
 
-	if (ioctl(file_i2c, I2C_SLAVE, iAddr) < 0) {
-		fprintf(stderr, "Failed to acquire bus access or talk to slave\n");
-		file_i2c = 0;
-		return 1;
+		if (ioctl(pOLED->file_i2c, I2C_SLAVE, iAddr) < 0) {
+			fprintf(stderr, "Failed to acquire bus access or talk to slave\n");
+			close(pOLED->file_i2c);
+			pOLED->file_i2c = 0;
+			return 1;
+		}
+		// Combined transactions need plain I2C support from the adapter
+		pOLED->bRdwr = (ioctl(pOLED->file_i2c, I2C_FUNCS, &ulFuncs) == 0 && (ulFuncs & I2C_FUNC_I2C));
 	}
+	pOLED->bReady = 1;
 
+	pOLED->iWidth = oledColumnCount(pOLED);
+	pOLED->iHeight = oledPageCount(pOLED) * 8;
 	if (iType == OLED_128x32) {
-		_width = 128;
-		_height = 32;
-		write(file_i2c, oled32_initbuf, sizeof(oled32_initbuf));
-	} else {
-		_width = 128;
-		_height = 64;
-		write(file_i2c, oled64_initbuf, sizeof(oled64_initbuf));
+		pInit = oled32_initbuf;
+		iInitLen = sizeof(oled32_initbuf);
+	} else {	// 64x32 is driven as 64 rows and shows the middle of it
+		pInit = oled64_initbuf;
+		iInitLen = sizeof(oled64_initbuf);
 	}
+	oledResetClipCtx(pOLED);
+	for (i=0; i<OLED_MAX_SPRITES; i++)
+		pOLED->sprites[i].bVisible = 0;
+	pOLED->bScrolling = pOLED->bFlushHeld = 0;
+	pOLED->iStartPage = pOLED->iStartSent = 0; // the init sequence sends 0x40
+	pOLED->iShownValid = 0; // display memory is unknown
+	pOLED->bRepaint = 0;
+	pOLED->bCursorValid = 0;
+	oledQueueCommand(pOLED, 0x2e); // stop a scroll left running by someone else
+	for (i=1; i<iInitLen; i++) // skip the command introducer
+		oledQueueCommand(pOLED, pInit[i]);
 	if (bInvert) {
-		uc[0] = 0; // command
-		uc[1] = 0xa7; // invert command
-		write(file_i2c, uc, 2);
+		oledQueueCommand(pOLED, 0xa7); // invert command
 	}
 	if (bFlip) {	// rotate display 180
-		uc[0] = 0; // command
-		uc[1] = 0xa0;
-		write(file_i2c, uc, 2);
-		uc[1] = 0xc0;
-		write(file_i2c, uc, 2);
+		oledQueueCommand(pOLED, 0xa0);
+		oledQueueCommand(pOLED, 0xc0);
+	}
+	if (iType == OLED_132x64) // SH1106 only has page addressing
+		pOLED->iAddrMode = OLED_ADDR_PAGE;
+	if (pOLED->iAddrMode != OLED_ADDR_PAGE) {
+		oledQueueCommand(pOLED, 0x20);
+		oledQueueCommand(pOLED, pOLED->iAddrMode == OLED_ADDR_HORIZONTAL ? 0x00 : 0x01);
 	}
+	oledCommit(pOLED);
+	return 0;
+}
+
+// Select page, horizontal or vertical memory addressing
+// Can be called before oledInit() to choose the mode used at init time
+// Horizontal and vertical modes let oledFlush() send a rectangular
+// region (or the whole display) as one continuous data transfer
+// The SH1106 (OLED_132x64) only supports page addressing
+int oledSetAddressingModeCtx(oled_t *pOLED, int iMode) {
+	const unsigned char ucModes[] = {0x02, 0x00, 0x01};
+
+	if (iMode < OLED_ADDR_PAGE || iMode > OLED_ADDR_VERTICAL)
+		return -1;
+	if (pOLED->bReady && pOLED->iType == OLED_132x64 && iMode != OLED_ADDR_PAGE)
+		return -1;
+
+	if (!pOLED->bReady) {	// oledInit() sends it
+		pOLED->iAddrMode = iMode;
+		return 0;
+	}
+	oledWaitIdle(pOLED); // the flush thread may be sending in the old mode
+	pOLED->iAddrMode = iMode;
+	pOLED->bCursorValid = 0;
+	oledWriteCommand2(pOLED, 0x20, ucModes[iMode]);
 	return 0;
 }
 
 // Sends a command to turn off the OLED display
 // Closes the I2C file handle
-void oledShutdown() {
-	if (file_i2c != 0) {
-		oledWriteCommand(0xaE); // turn off OLED
-		close(file_i2c);
-		file_i2c = 0;
+void oledShutdownCtx(oled_t *pOLED) {
+	if (pOLED->bReady) {
+		oledSetAsyncCtx(pOLED, 0); // let the flush thread finish its frame
+		if (pOLED->ppPanels == NULL)
+			oledWriteCommand(pOLED, 0xaE); // turn off OLED
+		if (pOLED->file_i2c != 0)
+			close(pOLED->file_i2c);
+		pOLED->file_i2c = 0;
+		pOLED->bReady = 0;
+		pOLED->bDeferred = 0;
+		oledClearDirty(pOLED);
 	}
 }
 
-// Send a single byte command to the OLED controller
-static void oledWriteCommand(unsigned char c) {
-	unsigned char buf[2];
-	int rc;
+// Allocate a context for one more display
+// Returns NULL if out of memory
+oled_t *oledCreate(void) {
+	oled_t *pOLED = calloc(1, sizeof(oled_t));
+
+	if (pOLED == NULL)
+		return NULL;
+	pOLED->ucScreen = pOLED->ucFrames[0];
+	pOLED->ucFront = pOLED->ucFrames[1];
+	pOLED->ucShown = pOLED->ucFrames[2];
+	pOLED->iPitch = 128;
+	pOLED->iPages = 8;
+	pOLED->iDirtyMin = pOLED->iSpans[0];
+	pOLED->iDirtyMax = pOLED->iSpans[1];
+	pOLED->iFrontMin = pOLED->iSpans[2];
+	pOLED->iFrontMax = pOLED->iSpans[3];
+	pOLED->iAddrMode = OLED_ADDR_PAGE;
+	pOLED->iFillRule = OLED_FILL_EVENODD;
+	pOLED->iClipX1 = 127;
+	pOLED->iClipY1 = 63;
+	pthread_mutex_init(&pOLED->mtxFlush, NULL);
+	pthread_cond_init(&pOLED->cvFlush, NULL);
+	return pOLED;
+}
+
+// Shut the display down and free its context
+// The panels of a video wall are left alone
+void oledDestroy(oled_t *pOLED) {
+	if (pOLED == NULL || pOLED == &oledDefault)
+		return;
+	oledShutdownCtx(pOLED);
+	pthread_mutex_destroy(&pOLED->mtxFlush);
+	pthread_cond_destroy(&pOLED->cvFlush);
+	if (pOLED->ucScreen != pOLED->ucFrames[0]) {	// a wall's own buffers
+		free(pOLED->ucScreen);
+		free(pOLED->ucFront);
+		free(pOLED->iDirtyMin);
+	}
+	free(pOLED->ppPanels); // NULL unless it's a wall
+	free(pOLED->ppFlush);
+	free(pOLED);
+}
+
+// Create a video wall: one canvas of iCols x iRows 128x64 panels
+// Draw on it with the Ctx functions like on any display; each panel
+// is sent its part of the changes when the wall is flushed.
+// Returns NULL if out of memory
+oled_t *oledWallCreate(int iCols, int iRows) {
+	oled_t *pOLED;
+	int iPages, iSize;
+
+	if (iCols < 1 || iRows < 1)
+		return NULL;
+	pOLED = oledCreate();
+	if (pOLED == NULL)
+		return NULL;
+	iPages = iRows * 8;
+	iSize = iCols * 128 * iPages;
+	pOLED->iPitch = iCols * 128;
+	pOLED->iPages = iPages;
+	pOLED->iWallCols = iCols;
+	pOLED->iWallRows = iRows;
+	pOLED->ucScreen = calloc(iSize, 1);
+	pOLED->ucFront = calloc(iSize, 1);
+	pOLED->ucShown = NULL; // the panels compare their own
+	pOLED->iDirtyMin = malloc(4 * iPages * sizeof(int)); // all four span arrays
+	pOLED->ppPanels = calloc(iCols * iRows, sizeof(oled_t *));
+	pOLED->ppFlush = calloc(iCols * iRows, sizeof(oled_t *));
+	if (pOLED->ucScreen == NULL || pOLED->ucFront == NULL || pOLED->iDirtyMin == NULL ||
+	    pOLED->ppPanels == NULL || pOLED->ppFlush == NULL) {
+		oledDestroy(pOLED);
+		return NULL;
+	}
+	pOLED->iDirtyMax = pOLED->iDirtyMin + iPages;
+	pOLED->iFrontMin = pOLED->iDirtyMin + 2*iPages;
+	pOLED->iFrontMax = pOLED->iDirtyMin + 3*iPages;
+	pOLED->iWidth = pOLED->iPitch;
+	pOLED->iHeight = iPages * 8;
+	pOLED->iType = OLED_128x64;
+	pOLED->bReady = 1; // the wall itself has no bus to open
+	oledClearDirty(pOLED);
+	oledResetClipCtx(pOLED);
+	return pOLED;
+}
+
+// Place an initialized 128x64 display at column iCol, row iRow of a wall
+// The panel keeps its own bus and address; pass NULL to remove it.
+// Returns 0 for success, -1 for a bad position or panel type
+int oledWallAttach(oled_t *pWall, int iCol, int iRow, oled_t *pPanel) {
+	int y;
+
+	if (pWall->ppPanels == NULL || iCol < 0 || iCol >= pWall->iWallCols ||
+	    iRow < 0 || iRow >= pWall->iWallRows)
+		return -1;
+	if (pPanel != NULL && (!pPanel->bReady || pPanel->ppPanels != NULL ||
+	    oledPageCount(pPanel) != 8 || oledColumnCount(pPanel) != 128))
+		return -1;
+	oledWaitIdle(pWall);
+	pWall->ppPanels[iRow * pWall->iWallCols + iCol] = pPanel;
+	if (pPanel != NULL) {	// show what the wall has there at the next flush
+		for (y=iRow*8; y<iRow*8 + 8; y++)
+			oledMarkDirty(pWall, y, iCol*128, iCol*128 + 127);
+	}
+	return 0;
+}
+
+// Replace the I2C transport with a user supplied function
+// Must be called before oledInit(); NULL restores the I2C bus
+void oledSetTransportCtx(oled_t *pOLED, OLEDTRANSPORT pfnXfer, void *pUser) {
+	pOLED->pfnTransport = pfnXfer;
+	pOLED->pTransportUser = pUser;
+}
+
+// Deliver a transaction to the display with a single I2C_RDWR ioctl
+// Falls back to one write() per message if the adapter can't do that
+static int oledI2CTransfer(oled_t *pOLED, OLEDMSG *pMsgs, int iCount) {
+	struct i2c_msg msgs[OLED_MAX_MSGS];
+	struct i2c_rdwr_ioctl_data xfer;
+	int i;
 
-	buf[0] = 0x00; // command introducer
-	buf[1] = c;
-	rc = write(file_i2c, buf, 2);
-	if (rc) {} // suppress warning
+	if (pOLED->bRdwr) {
+		for (i=0; i<iCount; i++) {
+			msgs[i].addr = pOLED->iAddr;
+			msgs[i].flags = 0; // write
+			msgs[i].len = pMsgs[i].iLen;
+			msgs[i].buf = pMsgs[i].pData;
+		}
+		xfer.msgs = msgs;
+		xfer.nmsgs = iCount;
+		return (ioctl(pOLED->file_i2c, I2C_RDWR, &xfer) < 0) ? -1 : 0;
+	}
+	for (i=0; i<iCount; i++) {
+		if (write(pOLED->file_i2c, pMsgs[i].pData, pMsgs[i].iLen) != pMsgs[i].iLen)
+			return -1;
+	}
+	return 0;
 }
 
-static void oledWriteCommand2(unsigned char c, unsigned char d) {
-	unsigned char buf[3];
+// Send the pending transaction to the display
+// Returns 0 for success, -1 if the transport failed
+static int oledCommit(oled_t *pOLED) {
 	int rc;
 
-	buf[0] = 0x00;
-	buf[1] = c;
-	buf[2] = d;
-	rc = write(file_i2c, buf, 3);
-	if (rc) {} // suppress warning
+	if (pOLED->iMsgCount == 0)
+		return 0;
+	if (pOLED->pBus == NULL) {	// a video wall has no bus of its own
+		pOLED->iMsgCount = pOLED->iXferLen = pOLED->bCmdOpen = 0;
+		return -1;
+	}
+	pthread_mutex_lock(&pOLED->pBus->mtxBus);
+	if (pOLED->pfnTransport)
+		rc = (*pOLED->pfnTransport)(pOLED->pTransportUser, pOLED->oledMsgs, pOLED->iMsgCount);
+	else
+		rc = oledI2CTransfer(pOLED, pOLED->oledMsgs, pOLED->iMsgCount);
+	pthread_mutex_unlock(&pOLED->pBus->mtxBus);
+	pOLED->iMsgCount = pOLED->iXferLen = pOLED->bCmdOpen = 0;
+	if (rc != 0) {	// some of it may not have arrived
+		pOLED->bCursorValid = 0;
+		pOLED->iShownValid = 0; // resend whole pages until they are known again
+		pOLED->iStartSent = -1; // and the start line with the next frame
+		pOLED->bRepaint = 1; // the changes it carried are no longer dirty
+	}
+	return rc;
+}
+
+// Start a new message in the pending transaction
+// If it can't hold another message of iLen bytes, it is committed first
+static void oledBeginMessage(oled_t *pOLED, unsigned char ucControl, int iLen) {
+	if (pOLED->iMsgCount == OLED_MAX_MSGS || pOLED->iXferLen + iLen + 1 > OLED_XFER_SIZE)
+		oledCommit(pOLED);
+	pOLED->oledMsgs[pOLED->iMsgCount].pData = &pOLED->ucXfer[pOLED->iXferLen];
+	pOLED->oledMsgs[pOLED->iMsgCount].iLen = 1;
+	pOLED->iMsgCount++;
+	pOLED->ucXfer[pOLED->iXferLen++] = ucControl;
 }
 
-int oledSetContrast(unsigned char ucContrast) {
-        if (file_i2c == 0)
+// Add a command byte to the pending transaction
+// The controller accepts any number of commands after a single 0x00
+// introducer, so consecutive commands share one message
+static void oledQueueCommand(oled_t *pOLED, unsigned char c) {
+	if (!pOLED->bCmdOpen || pOLED->iXferLen == OLED_XFER_SIZE) {
+		oledBeginMessage(pOLED, 0x00, 1); // command introducer
+		pOLED->bCmdOpen = 1;
+	}
+	pOLED->ucXfer[pOLED->iXferLen++] = c;
+	pOLED->oledMsgs[pOLED->iMsgCount-1].iLen++;
+}
+
+// Add a block of pixel data to the pending transaction
+// Length can be anything from 1 to 1024 (whole display)
+static void oledQueueData(oled_t *pOLED, unsigned char *ucBuf, int iLen) {
+	oledBeginMessage(pOLED, 0x40, iLen); // data introducer
+	memcpy(&pOLED->ucXfer[pOLED->iXferLen], ucBuf, iLen);
+	pOLED->iXferLen += iLen;
+	pOLED->oledMsgs[pOLED->iMsgCount-1].iLen += iLen;
+	pOLED->bCmdOpen = 0;
+	// In page mode the column advances with each byte (and wraps at
+	// the end of the page, where the mirror gives up)
+	pOLED->iCursorCol += iLen;
+	if (pOLED->iAddrMode != OLED_ADDR_PAGE || pOLED->iCursorCol >= ((pOLED->iType == OLED_132x64) ? 132 : 128))
+		pOLED->bCursorValid = 0;
+}
+
+// Add columns x0-x1 of pages y0-y1 of a frame buffer to the pending
+// transaction as one data message, in the order the current
+// addressing mode fills the window set by oledSendWindow()
+static void oledQueueRect(oled_t *pOLED, unsigned char *pBuf, int x0, int x1, int y0, int y1) {
+	int x, y, iLen;
+	unsigned char *d;
+
+	iLen = (x1 - x0 + 1) * (y1 - y0 + 1);
+	oledBeginMessage(pOLED, 0x40, iLen); // data introducer
+	d = &pOLED->ucXfer[pOLED->iXferLen];
+	if (pOLED->iAddrMode == OLED_ADDR_VERTICAL) {
+		for (x=x0; x<=x1; x++)
+			for (y=y0; y<=y1; y++)
+				*d++ = pBuf[y*pOLED->iPitch + x];
+	} else {
+		for (y=y0; y<=y1; y++) {
+			memcpy(d, &pBuf[y*pOLED->iPitch + x0], x1 - x0 + 1);
+			d += x1 - x0 + 1;
+		}
+	}
+	pOLED->iXferLen += iLen;
+	pOLED->oledMsgs[pOLED->iMsgCount-1].iLen += iLen;
+	pOLED->bCmdOpen = 0;
+	pOLED->bCursorValid = 0; // not tracked through a window
+}
+
+// Send a single byte command to the OLED controller
+static void oledWriteCommand(oled_t *pOLED, unsigned char c) {
+	oledQueueCommand(pOLED, c);
+	oledCommit(pOLED);
+}
+
+static void oledWriteCommand2(oled_t *pOLED, unsigned char c, unsigned char d) {
+	oledQueueCommand(pOLED, c);
+	oledQueueCommand(pOLED, d);
+	oledCommit(pOLED);
+}
+
+// Translate a column and page of the local copy to display memory
+// After the console has scrolled, pages are rotated by the start line
+static void oledMapPosition(oled_t *pOLED, int *x, int *y) {
+	if (pOLED->iType == OLED_64x32) {	// visible display starts at column 32, row 4
+		*x += 32; // display is centered in VRAM, so this is always true
+		if (pOLED->bFlip == 0) // non-flipped display starts from line 4
+		*y += 4;
+	} else if (pOLED->iType == OLED_132x64) {	// SH1106 has 128 pixels centered in 132
+		*x += 2;
+	}
+	*y = (*y + pOLED->iStartPage) & 7;
+}
+
+int oledSetContrastCtx(oled_t *pOLED, unsigned char ucContrast) {
+        if (!pOLED->bReady)
                 return -1;
 
-	oledWriteCommand2(0x81, ucContrast);
+	oledWaitIdle(pOLED);
+	if (pOLED->ppPanels) {	// set it on every panel of a wall
+		int i;
+		for (i=0; i<pOLED->iWallCols * pOLED->iWallRows; i++) {
+			if (pOLED->ppPanels[i])
+				oledSetContrastCtx(pOLED->ppPanels[i], ucContrast);
+		}
+		return 0;
+	}
+	oledWriteCommand2(pOLED, 0x81, ucContrast);
 	return 0;
 }
 
+// Stop the hardware scroll
+// The scroll moved the pixels around in display memory, so the pages it
+// covered are rewritten right away, from the last presented frame when
+// the flush thread is running. Changes held back while it ran go out with
+// them, unless they are of a deferred frame that hasn't been flushed.
+int oledScrollStopCtx(oled_t *pOLED) {
+	int y, iMin[8], iMax[8], *pMin, *pMax;
+	unsigned char *pBuf;
+
+	if (!pOLED->bReady || pOLED->ppPanels)
+		return -1;
+	if (!pOLED->bScrolling)
+		return 0;
+	oledWaitIdle(pOLED);
+	oledQueueCommand(pOLED, 0x2e); // deactivate scroll
+	pOLED->bScrolling = 0;
+	pOLED->bCursorValid = 0;
+	pBuf = pOLED->ucScreen;
+	pMin = iMin;
+	pMax = iMax;
+	for (y=0; y<8; y++) {
+		iMin[y] = 0;
+		iMax[y] = -1;
+	}
+	if (pOLED->bAsync) {	// presented frames
+		pBuf = pOLED->ucFront;
+		pMin = pOLED->iFrontMin;
+		pMax = pOLED->iFrontMax;
+	} else if (!pOLED->bDeferred || pOLED->bFlushHeld) {
+		pMin = pOLED->iDirtyMin;
+		pMax = pOLED->iDirtyMax;
+	}
+	pOLED->bFlushHeld = 0;
+	for (y=pOLED->iScrollP0; y<=pOLED->iScrollP1; y++) {
+		pMin[y] = 0;
+		pMax[y] = oledColumnCount(pOLED)-1;
+		pOLED->iShownValid &= ~(1 << y);
+	}
+	return oledSendFrame(pOLED, pBuf, pMin, pMax);
+}
+
+// Start a continuous hardware scroll of pages iStartPage-iEndPage
+// iDir is one of the OLED_SCROLL_* directions; the display moves the
+// pixels one column every iFrames frames (2-256, the nearest step the
+// controller has is used) without any traffic on the bus.
+// Diagonal scrolls also move the scroll area (oledSetScrollArea()) up
+// by iVertical rows (0-63) per step.
+// Not available on the SH1106 (OLED_132x64) or a video wall.
+int oledScrollStartCtx(oled_t *pOLED, int iDir, int iStartPage, int iEndPage, int iFrames, int iVertical) {
+	static const int iSteps[8] = {5, 64, 128, 256, 3, 4, 25, 2}; // frames for each interval code
+	int i, iCode, x = 0, p0 = iStartPage, p1 = iEndPage;
+
+	if (!pOLED->bReady || pOLED->ppPanels || pOLED->iType == OLED_132x64)
+		return -1;
+	if (iDir < OLED_SCROLL_RIGHT || iDir > OLED_SCROLL_DIAG_LEFT)
+		return -1;
+	if (iStartPage < 0 || iStartPage > iEndPage || iEndPage >= oledPageCount(pOLED) || iVertical < 0 || iVertical > 63)
+		return -1;
+	oledWaitIdle(pOLED); // the flush thread must not be using the queue
+	oledScrollStopCtx(pOLED); // the scroll setup must not change while it runs
+	iCode = 0;
+	for (i=1; i<8; i++)
+		if (abs(iSteps[i] - iFrames) < abs(iSteps[iCode] - iFrames))
+			iCode = i;
+	oledMapPosition(pOLED, &x, &p0);
+	oledMapPosition(pOLED, &x, &p1);
+	if (p1 < p0)
+		return -1; // the console's start line split the range in display memory
+	oledQueueCommand(pOLED, 0x2e); // deactivate before setting it up
+	if (iDir == OLED_SCROLL_RIGHT || iDir == OLED_SCROLL_LEFT) {
+		oledQueueCommand(pOLED, iDir == OLED_SCROLL_RIGHT ? 0x26 : 0x27);
+		oledQueueCommand(pOLED, 0x00); // dummy byte
+		oledQueueCommand(pOLED, p0);
+		oledQueueCommand(pOLED, iCode);
+		oledQueueCommand(pOLED, p1);
+		oledQueueCommand(pOLED, 0x00);
+		oledQueueCommand(pOLED, 0xff);
+	} else {
+		oledQueueCommand(pOLED, iDir == OLED_SCROLL_DIAG_RIGHT ? 0x29 : 0x2a);
+		oledQueueCommand(pOLED, 0x00); // dummy byte
+		oledQueueCommand(pOLED, p0);
+		oledQueueCommand(pOLED, iCode);
+		oledQueueCommand(pOLED, p1);
+		oledQueueCommand(pOLED, iVertical);
+	}
+	oledQueueCommand(pOLED, 0x2f); // activate scroll
+	pOLED->bScrolling = 1;
+	pOLED->bCursorValid = 0;
+	pOLED->iScrollP0 = iStartPage;
+	pOLED->iScrollP1 = iEndPage;
+	return oledCommit(pOLED);
+}
+
+// Set the rows a diagonal scroll moves: iRows rows after iTopRows fixed
+// ones at the top of the display
+int oledSetScrollAreaCtx(oled_t *pOLED, int iTopRows, int iRows) {
+	if (!pOLED->bReady || pOLED->ppPanels || pOLED->iType == OLED_132x64)
+		return -1;
+	if (iTopRows < 0 || iRows < 0 || iTopRows + iRows > oledPageCount(pOLED)*8)
+		return -1;
+	oledWaitIdle(pOLED);
+	if (pOLED->iType == OLED_64x32 && pOLED->bFlip == 0)
+		iTopRows += 32; // visible display starts from line 32
+	oledQueueCommand(pOLED, 0xa3);
+	oledQueueCommand(pOLED, iTopRows);
+	oledQueueCommand(pOLED, iRows);
+	return oledCommit(pOLED);
+}
+
+// Move pages iStartPage-iEndPage of the local copy iDx pixels right
+// (or left if negative), clearing the columns that scroll in
+// Unlike the hardware scroll this keeps the local copy in step with
+// the display, at the cost of sending the pages again.
+int oledScrollPagesCtx(oled_t *pOLED, int iStartPage, int iEndPage, int iDx) {
+	int y, iCols;
+	unsigned char *d;
+
+	if (!pOLED->bReady)
+		return -1;
+	if (iStartPage < 0 || iStartPage > iEndPage || iEndPage >= oledPageCount(pOLED))
+		return -1;
+	iCols = oledColumnCount(pOLED);
+	if (iDx > iCols) iDx = iCols;
+	if (iDx < -iCols) iDx = -iCols;
+	if (iDx == 0)
+		return 0;
+	for (y=iStartPage; y<=iEndPage; y++) {
+		d = &pOLED->ucScreen[y*pOLED->iPitch];
+		if (iDx > 0) {
+			memmove(&d[iDx], d, iCols - iDx);
+			memset(d, 0, iDx);
+		} else {
+			memmove(d, &d[-iDx], iCols + iDx);
+			memset(&d[iCols + iDx], 0, -iDx);
+		}
+		oledMarkDirty(pOLED, y, 0, iCols-1);
+	}
+	return oledUpdate(pOLED);
+}
+
+// Send commands to limit writes to columns x0-x1 of pages y0-y1
+// (horizontal and vertical addressing modes only)
+static void oledSendWindow(oled_t *pOLED, int x0, int x1, int y0, int y1) {
+	oledMapPosition(pOLED, &x0, &y0);
+	oledMapPosition(pOLED, &x1, &y1);
+	oledQueueCommand(pOLED, 0x21); // column start and end
+	oledQueueCommand(pOLED, x0);
+	oledQueueCommand(pOLED, x1);
+	oledQueueCommand(pOLED, 0x22); // page start and end
+	oledQueueCommand(pOLED, y0);
+	oledQueueCommand(pOLED, y1);
+}
+
 // Send commands to position the "cursor" to the given
 // row and column
-static void oledSetPosition(int x, int y) {
-	iScreenOffset = (y*128)+x;
-	if (oled_type == OLED_64x32) {	// visible display starts at column 32, row 4
-		x += 32; // display is centered in VRAM, so this is always true
-		if (oled_flip == 0) // non-flipped display starts from line 4
-		y += 4;
-	} else if (oled_type == OLED_132x64) {	// SH1106 has 128 pixels centered in 132
-		x += 2;
+// In page mode only the parts (page, low and high column nibble) that
+// differ from where the controller's pointer already is are sent
+static void oledSendPosition(oled_t *pOLED, int x, int y) {
+	if (pOLED->iAddrMode != OLED_ADDR_PAGE) {	// window to the rest of the page
+		oledSendWindow(pOLED, x, oledColumnCount(pOLED)-1, y, y);
+		return;
 	}
+	oledMapPosition(pOLED, &x, &y);
+
+	if (!pOLED->bCursorValid || pOLED->iCursorPage != y)
+		oledQueueCommand(pOLED, 0xb0 | y); // go to page Y
+	else
+		pOLED->ulSkipped++;
+	if (!pOLED->bCursorValid || (pOLED->iCursorCol & 0xf) != (x & 0xf))
+		oledQueueCommand(pOLED, 0x00 | (x & 0xf)); // // lower col addr
+	else
+		pOLED->ulSkipped++;
+	if (!pOLED->bCursorValid || (pOLED->iCursorCol >> 4) != (x >> 4))
+		oledQueueCommand(pOLED, 0x10 | ((x >> 4) & 0xf)); // upper col addr
+	else
+		pOLED->ulSkipped++;
+	pOLED->bCursorValid = 1;
+	pOLED->iCursorPage = y;
+	pOLED->iCursorCol = x;
+}
 
-	oledWriteCommand(0xb0 | y); // go to page Y
-	oledWriteCommand(0x00 | (x & 0xf)); // // lower col addr
-	oledWriteCommand(0x10 | ((x >> 4) & 0xf)); // upper col addr
+// Number of position command bytes left out because the controller was
+// already there; a video wall adds up its panels
+unsigned long oledSkippedCommandsCtx(oled_t *pOLED) {
+	unsigned long ulCount = pOLED->ulSkipped;
+	int i;
+
+	for (i=0; pOLED->ppPanels && i<pOLED->iWallCols * pOLED->iWallRows; i++) {
+		if (pOLED->ppPanels[i])
+			ulCount += pOLED->ppPanels[i]->ulSkipped;
+	}
+	return ulCount;
 }
 
-// Write a block of pixel data to the OLED
-// Length can be anything from 1 to 1024 (whole display)
-static void oledWriteDataBlock(unsigned char *ucBuf, int iLen) {
-	unsigned char ucTemp[129];
-	int rc;
+// Set the local write offset to the given row and column
+// and position the display "cursor" there unless drawing is deferred
+static void oledSetPosition(oled_t *pOLED, int x, int y) {
+	pOLED->iScreenOffset = (y*pOLED->iPitch)+x;
+	if (!pOLED->bDeferred && pOLED->ppPanels == NULL && !pOLED->bScrolling)
+		oledSendPosition(pOLED, x, y);
+}
+
+// Mark columns x0 to x1 of page y as changed since the last flush
+static void oledMarkDirty(oled_t *pOLED, int y, int x0, int x1) {
+	if (x0 < pOLED->iDirtyMin[y])
+		pOLED->iDirtyMin[y] = x0;
+	if (x1 > pOLED->iDirtyMax[y])
+		pOLED->iDirtyMax[y] = x1;
+}
+
+// Forget all pending changes
+static void oledClearDirty(oled_t *pOLED) {
+	int y;
+
+	for (y=0; y<pOLED->iPages; y++) {
+		pOLED->iDirtyMin[y] = pOLED->iPitch;
+		pOLED->iDirtyMax[y] = -1;
+	}
+}
+
+// Send what a drawing function changed in the local copy
+// unless drawing is deferred
+static int oledUpdate(oled_t *pOLED) {
+	if (pOLED->bDeferred)
+		return 0;
+	return oledSendFrame(pOLED, pOLED->ucScreen, pOLED->iDirtyMin, pOLED->iDirtyMax);
+}
+
+// Set or clear every pixel from (x0,y0) to (x1,y1) inclusive
+// Works a byte (8 vertical pixels) at a time: the top and bottom pages
+// of the span get a mask, the pages in between are stored whole
+static void oledFillRect(oled_t *pOLED, int x0, int y0, int x1, int y1, unsigned char ucColor) {
+	int x, y, iLen;
+	unsigned char ucMask, ucTop, ucBottom, *d;
+
+	if (x0 < pOLED->iClipX0) x0 = pOLED->iClipX0;
+	if (y0 < pOLED->iClipY0) y0 = pOLED->iClipY0;
+	if (x1 > pOLED->iClipX1) x1 = pOLED->iClipX1;
+	if (y1 > pOLED->iClipY1) y1 = pOLED->iClipY1;
+	if (x0 > x1 || y0 > y1)
+		return; // outside the clip rectangle
+
+	iLen = x1 - x0 + 1;
+	ucTop = 0xff << (y0 & 7);
+	ucBottom = 0xff >> (7 - (y1 & 7));
+	for (y=(y0 >> 3); y<=(y1 >> 3); y++) {
+		ucMask = 0xff;
+		if (y == (y0 >> 3))
+			ucMask &= ucTop;
+		if (y == (y1 >> 3))
+			ucMask &= ucBottom;
+		d = &pOLED->ucScreen[y*pOLED->iPitch + x0];
+		if (ucMask == 0xff) {
+			memset(d, ucColor ? 0xff : 0x00, iLen);
+		} else if (ucColor) {
+			for (x=0; x<iLen; x++)
+				d[x] |= ucMask;
+		} else {
+			ucMask = ~ucMask;
+			for (x=0; x<iLen; x++)
+				d[x] &= ucMask;
+		}
+		oledMarkDirty(pOLED, y, x0, x1);
+	}
+}
+
+// Set or clear pixels x0 to x1 of row y
+// One bit mask is applied across a run of bytes in a single page
+static void oledHSpan(oled_t *pOLED, int x0, int x1, int y, unsigned char ucColor) {
+	int x;
+	unsigned char ucMask, *d;
+
+	if (y < pOLED->iClipY0 || y > pOLED->iClipY1)
+		return;
+	if (x0 < pOLED->iClipX0) x0 = pOLED->iClipX0;
+	if (x1 > pOLED->iClipX1) x1 = pOLED->iClipX1;
+	if (x0 > x1)
+		return;
+
+	ucMask = 1 << (y & 7);
+	d = &pOLED->ucScreen[(y >> 3)*pOLED->iPitch];
+	if (ucColor) {
+		for (x=x0; x<=x1; x++)
+			d[x] |= ucMask;
+	} else {
+		ucMask = ~ucMask;
+		for (x=x0; x<=x1; x++)
+			d[x] &= ucMask;
+	}
+	oledMarkDirty(pOLED, y >> 3, x0, x1);
+}
+
+// Set or clear pixels y0 to y1 of column x
+// Touches one masked byte per page of the column
+static void oledVSpan(oled_t *pOLED, int x, int y0, int y1, unsigned char ucColor) {
+	oledFillRect(pOLED, x, y0, x, y1, ucColor);
+}
+
+// Limit drawing to the w x h rectangle at (x,y)
+// The rectangle is trimmed to the screen; an empty one hides everything
+int oledSetClipCtx(oled_t *pOLED, int x, int y, int w, int h) {
+	if (!pOLED->bReady)
+		return -1;
+	pOLED->iClipX0 = (x < 0) ? 0 : x;
+	pOLED->iClipY0 = (y < 0) ? 0 : y;
+	pOLED->iClipX1 = (w > 0) ? x + w - 1 : x - 1;
+	pOLED->iClipY1 = (h > 0) ? y + h - 1 : y - 1;
+	if (pOLED->iClipX1 >= oledColumnCount(pOLED))
+		pOLED->iClipX1 = oledColumnCount(pOLED) - 1;
+	if (pOLED->iClipY1 >= oledPageCount(pOLED)*8)
+		pOLED->iClipY1 = oledPageCount(pOLED)*8 - 1;
+	return 0;
+}
+
+// Allow drawing on the whole screen again
+int oledResetClipCtx(oled_t *pOLED) {
+	pOLED->iClipX0 = pOLED->iClipY0 = 0;
+	pOLED->iClipX1 = oledColumnCount(pOLED) - 1;
+	pOLED->iClipY1 = oledPageCount(pOLED)*8 - 1;
+	return 0;
+}
+
+// Nonzero if the box (x0,y0)-(x1,y1) lies entirely outside the clip rectangle
+static int oledClipReject(oled_t *pOLED, int x0, int y0, int x1, int y1) {
+	return (x1 < pOLED->iClipX0 || x0 > pOLED->iClipX1 || y1 < pOLED->iClipY0 || y0 > pOLED->iClipY1);
+}
 
-	ucTemp[0] = 0x40; // data command
-	memcpy(&ucTemp[1], ucBuf, iLen);
-	rc = write(file_i2c, ucTemp, iLen+1);
-	if (rc) {} // suppress warning
+// Set or clear one pixel of the local copy
+static void oledPlot(oled_t *pOLED, int x, int y, unsigned char ucColor) {
+	unsigned char *d;
+
+	if (x < pOLED->iClipX0 || x > pOLED->iClipX1 || y < pOLED->iClipY0 || y > pOLED->iClipY1)
+		return; // clipped
+	d = &pOLED->ucScreen[(y >> 3)*pOLED->iPitch + x];
+	if (ucColor)
+		*d |= (1 << (y & 7));
+	else
+		*d &= ~(1 << (y & 7));
+	oledMarkDirty(pOLED, y >> 3, x, x);
+}
+
+// Replicate a byte into all 8 lanes of a 64-bit word
+#define OLED_LANES(b) (0x0101010101010101ULL * (unsigned char)(b))
+
+// Combine iLen bytes of src into dst under ucMask with a raster op
+// The source bytes are masked by ucSrcMask and shifted by iShift (down the
+// page if positive, up if negative). Eight columns are handled per 64-bit
+// word: each byte is a lane and the lane masks drop the bits a shift would
+// carry into the neighbouring column.
+static void oledMaskBytes(unsigned char *d, const unsigned char *src, int iLen, int iShift, unsigned char ucSrcMask, unsigned char ucMask, int iRop) {
+	int x;
+	unsigned char b;
+	uint64_t ullSrc, ullDst, ullMask, ullKeep;
+
+	ullMask = OLED_LANES(ucMask);
+	ullKeep = OLED_LANES(iShift >= 0 ? 0xff << iShift : 0xff >> -iShift);
+	for (x=0; x+8<=iLen; x+=8) {
+		memcpy(&ullSrc, &src[x], 8);
+		memcpy(&ullDst, &d[x], 8);
+		ullSrc &= OLED_LANES(ucSrcMask);
+		ullSrc = (iShift >= 0 ? ullSrc << iShift : ullSrc >> -iShift) & ullKeep;
+		switch (iRop) {
+			case OLED_ROP_OR:  ullDst |= ullSrc & ullMask; break;
+			case OLED_ROP_AND: ullDst &= ~ullMask | ullSrc; break;
+			case OLED_ROP_XOR: ullDst ^= ullSrc & ullMask; break;
+			case OLED_ROP_NOT: ullDst = (ullDst & ~ullMask) | (~ullSrc & ullMask); break;
+			default:           ullDst = (ullDst & ~ullMask) | (ullSrc & ullMask); break;
+		}
+		memcpy(&d[x], &ullDst, 8);
+	}
+	for (; x<iLen; x++) { // the last few columns
+		b = (unsigned char)(iShift >= 0 ? (src[x] & ucSrcMask) << iShift : (src[x] & ucSrcMask) >> -iShift);
+		switch (iRop) {
+			case OLED_ROP_OR:  d[x] |= b & ucMask; break;
+			case OLED_ROP_AND: d[x] &= ~ucMask | b; break;
+			case OLED_ROP_XOR: d[x] ^= b & ucMask; break;
+			case OLED_ROP_NOT: d[x] = (d[x] & ~ucMask) | (~b & ucMask); break;
+			default:           d[x] = (d[x] & ~ucMask) | (b & ucMask); break;
+		}
+	}
+}
+
+// Draw a w x h bitmap in page-major format (like ucScreen, iSrcPitch bytes
+// per page) with its top left corner at any pixel (x,y)
+// Each source page lands on two destination pages: it is shifted down by
+// y & 7 into the first and the bits that fall out go to the top of the
+// second. The masks for a pair of pages (bitmap height, clip rows) are the
+// same for every column, so the inner loop is a masked raster op on
+// 8 columns at a time.
+static void oledBlitPages(oled_t *pOLED, const unsigned char *pSrc, int iSrcPitch, int w, int h, int x, int y, int iRop) {
+	int sp, dp, iShift, x0, x1, iLen, iTop, iBot;
+	unsigned char ucSrcMask, ucMask;
+
+	x0 = (x > pOLED->iClipX0) ? x : pOLED->iClipX0;
+	x1 = (x + w - 1 < pOLED->iClipX1) ? x + w - 1 : pOLED->iClipX1;
+	if (x0 > x1 || h <= 0)
+		return;
+	iLen = x1 - x0 + 1;
+	pSrc += x0 - x;
+	iShift = y & 7; // same as the floor for negative y
+	for (sp=0; sp<(h + 7) >> 3; sp++, pSrc += iSrcPitch) {
+		ucSrcMask = (h - sp*8 >= 8) ? 0xff : (0xff >> (8 - (h - sp*8)));
+		// the two pages this source page touches
+		for (dp=((y >> 3) + sp); dp<=(y >> 3) + sp + (iShift != 0); dp++) {
+			iTop = dp*8; // rows of this page inside the clip
+			iBot = dp*8 + 7;
+			if (iTop < pOLED->iClipY0) iTop = pOLED->iClipY0;
+			if (iBot > pOLED->iClipY1) iBot = pOLED->iClipY1;
+			if (iTop > iBot)
+				continue;
+			ucMask = (0xff << (iTop & 7)) & (0xff >> (7 - (iBot & 7)));
+			if (dp == (y >> 3) + sp) {	// upper part of the source page
+				ucMask &= (unsigned char)(ucSrcMask << iShift);
+				oledMaskBytes(&pOLED->ucScreen[dp*pOLED->iPitch + x0], pSrc, iLen, iShift, ucSrcMask, ucMask, iRop);
+			} else {	// the bits shifted out of the bottom
+				ucMask &= ucSrcMask >> (8 - iShift);
+				oledMaskBytes(&pOLED->ucScreen[dp*pOLED->iPitch + x0], pSrc, iLen, iShift - 8, ucSrcMask, ucMask, iRop);
+			}
+			if (ucMask)
+				oledMarkDirty(pOLED, dp, x0, x1);
+		}
+	}
+}
+
+// Write a block of pixel data to the OLED
+// Length can be anything from 1 to 128 (one page)
+// In deferred mode (on a video wall, or during a hardware scroll) only the
+// local copy is updated
+static void oledWriteDataBlock(oled_t *pOLED, unsigned char *ucBuf, int iLen) {
+	int x = pOLED->iScreenOffset % pOLED->iPitch;
+
+	if (pOLED->bDeferred || pOLED->ppPanels || pOLED->bScrolling) {
+		oledMarkDirty(pOLED, pOLED->iScreenOffset / pOLED->iPitch, x, x + iLen - 1);
+	} else {
+		oledQueueData(pOLED, ucBuf, iLen);
+		memcpy(&pOLED->ucShown[pOLED->iScreenOffset], ucBuf, iLen);
+	}
 	// Keep a copy in local buffer
-	memcpy(&ucScreen[iScreenOffset], ucBuf, iLen);
-	iScreenOffset += iLen;
+	memcpy(&pOLED->ucScreen[pOLED->iScreenOffset], ucBuf, iLen);
+	pOLED->iScreenOffset += iLen;
 }
 
 // Set (or clear) an individual pixel
 // The local copy of the frame buffer is used to avoid
 // reading data from the display controller
-int oledSetPixel(int x, int y, unsigned char ucColor) {
+int oledSetPixelCtx(oled_t *pOLED, int x, int y, unsigned char ucColor) {
 	int i;
 	unsigned char uc, ucOld;
 
-	if (file_i2c == 0)
+	if (!pOLED->bReady)
 		return -1;
 
-	i = ((y >> 3) * 128) + x;
-	if (i < 0 || i > 1023) // off the screen
-		return -1;
-	uc = ucOld = ucScreen[i];
+	if (x < pOLED->iClipX0 || x > pOLED->iClipX1 || y < pOLED->iClipY0 || y > pOLED->iClipY1)
+		return -1; // clipped
+	i = ((y >> 3) * pOLED->iPitch) + x;
+	uc = ucOld = pOLED->ucScreen[i];
 	uc &= ~(0x1 << (y & 7));
 	if (ucColor) {
 		uc |= (0x1 << (y & 7));
 	}
 	if (uc != ucOld) {	// pixel changed
-		oledSetPosition(x, y>>3);
-		oledWriteDataBlock(&uc, 1);
+		if (pOLED->bDeferred || pOLED->ppPanels || pOLED->bScrolling) {	// through the local copy
+			pOLED->ucScreen[i] = uc;
+			oledMarkDirty(pOLED, y >> 3, x, x);
+			oledUpdate(pOLED);
+		} else {
+			oledSetPosition(pOLED, x, y>>3);
+			oledWriteDataBlock(pOLED, &uc, 1);
+			oledCommit(pOLED);
+		}
 	}
 	return 0;
 }
+
+// Select deferred mode (1) or immediate mode (0)
+// In deferred mode drawing functions only update the local copy of the
+// display and nothing is sent until oledFlush() is called.
+// Leaving deferred mode stops the flush thread and flushes any pending
+// changes.
+int oledSetDeferredCtx(oled_t *pOLED, int bDeferred) {
+	if (!pOLED->bReady)
+		return -1;
+
+	if (pOLED->bDeferred && !bDeferred) {
+		oledSetAsyncCtx(pOLED, 0);
+		oledFlushCtx(pOLED);
+	}
+	if (pOLED->bAsync && bDeferred)
+		pOLED->bAsyncDeferred = 1; // stay deferred when the thread stops
+	pOLED->bDeferred = bDeferred ? 1 : 0;
+	return 0;
+}
+
+// Send the changed parts of a video wall's frame buffer
+// Each panel's share of the dirty spans is copied into the panel's own
+// buffer, a page row at a time, and the changed panels are flushed
+// together so those on different buses are sent in parallel.
+static int oledWallSend(oled_t *pOLED, unsigned char *pBuf, int *pMin, int *pMax) {
+	int c, r, y, x0, x1, iCount = 0;
+	oled_t *pPanel;
+
+	for (r=0; r<pOLED->iWallRows; r++) {
+		for (c=0; c<pOLED->iWallCols; c++) {
+			pPanel = pOLED->ppPanels[r*pOLED->iWallCols + c];
+			if (pPanel == NULL)
+				continue;
+			int bChanged = 0;
+			for (y=0; y<8; y++) {
+				x0 = pMin[r*8 + y] - c*128;
+				x1 = pMax[r*8 + y] - c*128;
+				if (x0 < 0) x0 = 0;
+				if (x1 > 127) x1 = 127;
+				if (x0 > x1)
+					continue;
+				memcpy(&pPanel->ucScreen[y*128 + x0], &pBuf[(r*8 + y)*pOLED->iPitch + c*128 + x0], x1 - x0 + 1);
+				oledMarkDirty(pPanel, y, x0, x1);
+				bChanged = 1;
+			}
+			if (bChanged || pPanel->bRepaint)
+				pOLED->ppFlush[iCount++] = pPanel;
+		}
+	}
+	for (y=0; y<pOLED->iPages; y++) {
+		pMin[y] = pOLED->iPitch;
+		pMax[y] = -1;
+	}
+	return oledFlushMany(pOLED->ppFlush, iCount);
+}
+
+// Send the changed parts of a frame buffer to the OLED
+// The range of columns in pMin/pMax of each page (reset afterwards) is
+// first narrowed to the bytes that differ from what the display shows.
+// Within it, each run of changes gets a position command and a data
+// write; runs are merged when the unchanged bytes between them cost less
+// than another position command and message.
+// In horizontal or vertical addressing mode, the bounding rectangle of
+// all changes is sent as a single window instead when that puts fewer
+// bytes on the wire.
+static int oledSendFrame(oled_t *pOLED, unsigned char *pBuf, int *pMin, int *pMax) {
+	int x, y, x0, x1, iEnd, iLines, iCols, iSplit;
+	int y0, y1, iMinX, iMaxX, iPageCost, iPosCost, iWrapX, iWrapY0, iWrapY1;
+	unsigned char *s, *d;
+
+	if (pOLED->ppPanels)
+		return oledWallSend(pOLED, pBuf, pMin, pMax);
+	if (pOLED->bScrolling) {	// display memory can't be written
+		pOLED->bFlushHeld = 1; // the spans wait for oledScrollStop()
+		return 0;
+	}
+
+	iLines = oledPageCount(pOLED);
+	iCols = oledColumnCount(pOLED);
+	if (pOLED->bRepaint) {	// repair what a failed transfer left behind
+		pOLED->bRepaint = 0;
+		for (y=0; y<iLines; y++) {
+			pMin[y] = 0;
+			pMax[y] = iCols-1;
+		}
+	}
+	// Cost in bytes of each message is address + control + payload
+	iPosCost = (pOLED->iAddrMode == OLED_ADDR_PAGE) ? 3 : 6;
+	iSplit = 2 + iPosCost + 2; // a gap longer than this is worth skipping
+	iPageCost = 0;
+	y0 = iLines; y1 = -1;
+	iMinX = iCols; iMaxX = -1;
+	for (y=0; y<iLines; y++) {
+		x0 = pMin[y];
+		x1 = (pMax[y] < iCols) ? pMax[y] : iCols-1;
+		if (x0 <= x1 && (pOLED->iShownValid & (1 << y))) {	// drop what it already shows
+			s = &pBuf[y*pOLED->iPitch];
+			d = &pOLED->ucShown[y*pOLED->iPitch];
+			while (x0 <= x1 && s[x0] == d[x0])
+				x0++;
+			while (x1 >= x0 && s[x1] == d[x1])
+				x1--;
+			pMin[y] = x0;
+			pMax[y] = x1;
+		}
+		if (x0 > x1)
+			continue; // nothing changed on this page
+		iPageCost += 2 + iPosCost + 2 + (x1 - x0 + 1);
+		if (y < y0) y0 = y;
+		y1 = y;
+		if (x0 < iMinX) iMinX = x0;
+		if (x1 > iMaxX) iMaxX = x1;
+	}
+	if (pOLED->iStartSent != pOLED->iStartPage) {	// the console scrolled
+		oledQueueCommand(pOLED, 0x40 | (pOLED->iStartPage * 8));
+		pOLED->iStartSent = pOLED->iStartPage;
+	}
+	if (y1 < 0)
+		return oledCommit(pOLED); // nothing else to send
+
+	// A window can't wrap around the end of display memory
+	iWrapX = 0;
+	iWrapY0 = y0; iWrapY1 = y1;
+	oledMapPosition(pOLED, &iWrapX, &iWrapY0);
+	oledMapPosition(pOLED, &iWrapX, &iWrapY1);
+	if (pOLED->iAddrMode != OLED_ADDR_PAGE && iWrapY0 <= iWrapY1 &&
+	    2 + 6 + 2 + (iMaxX - iMinX + 1) * (y1 - y0 + 1) <= iPageCost) {
+		oledSendWindow(pOLED, iMinX, iMaxX, y0, y1);
+		oledQueueRect(pOLED, pBuf, iMinX, iMaxX, y0, y1);
+		for (y=y0; y<=y1; y++) {
+			memcpy(&pOLED->ucShown[y*pOLED->iPitch + iMinX], &pBuf[y*pOLED->iPitch + iMinX], iMaxX - iMinX + 1);
+			if (iMinX == 0 && iMaxX == iCols-1)
+				pOLED->iShownValid |= 1 << y;
+		}
+	} else {
+		for (y=y0; y<=y1; y++) {
+			x0 = pMin[y];
+			x1 = (pMax[y] < iCols) ? pMax[y] : iCols-1;
+			if (x0 > x1)
+				continue;
+			s = &pBuf[y*pOLED->iPitch];
+			d = &pOLED->ucShown[y*pOLED->iPitch];
+			for (x=x0; x<=x1; x=iEnd+1) {
+				iEnd = x1;
+				if (pOLED->iShownValid & (1 << y)) {	// end the run at a long enough gap
+					while (x <= x1 && s[x] == d[x])
+						x++; // skip to the next change
+					for (iEnd=x0=x; x<=x1 && x - iEnd - 1 <= iSplit; x++)
+						if (s[x] != d[x])
+							iEnd = x;
+					x = x0;
+				}
+				oledSendPosition(pOLED, x, y);
+				oledQueueData(pOLED, &s[x], iEnd - x + 1);
+			}
+			x0 = pMin[y];
+			memcpy(&d[x0], &s[x0], x1 - x0 + 1);
+			if (x0 == 0 && x1 == iCols-1)
+				pOLED->iShownValid |= 1 << y;
+		}
+	}
+	for (y=0; y<pOLED->iPages; y++) {
+		pMin[y] = pOLED->iPitch;
+		pMax[y] = -1;
+	}
+	return oledCommit(pOLED);
+}
+
+// Send the changed parts of the local copy to the OLED
+// With the flush thread running, this presents the frame and
+// waits for it to reach the display
+int oledFlushCtx(oled_t *pOLED) {
+	if (!pOLED->bReady)
+		return -1;
+
+	if (pOLED->bAsync) {
+		oledPresentCtx(pOLED);
+		oledWaitIdle(pOLED);
+		return pOLED->iFlushError;
+	}
+	return oledSendFrame(pOLED, pOLED->ucScreen, pOLED->iDirtyMin, pOLED->iDirtyMax);
+}
+
+// Flush thread: send each presented frame from ucFront
+static void *oledFlushThread(void *pArg) {
+	oled_t *pOLED = pArg;
+	int rc;
+
+	pthread_mutex_lock(&pOLED->mtxFlush);
+	for (;;) {
+		while (!pOLED->bFramePending && !pOLED->bFlushQuit)
+			pthread_cond_wait(&pOLED->cvFlush, &pOLED->mtxFlush);
+		if (!pOLED->bFramePending) // asked to quit and nothing left to send
+			break;
+		pthread_mutex_unlock(&pOLED->mtxFlush);
+		rc = oledSendFrame(pOLED, pOLED->ucFront, pOLED->iFrontMin, pOLED->iFrontMax);
+		pthread_mutex_lock(&pOLED->mtxFlush);
+		pOLED->iFlushError = rc;
+		pOLED->bFramePending = 0;
+		pthread_cond_broadcast(&pOLED->cvFlush);
+	}
+	pthread_mutex_unlock(&pOLED->mtxFlush);
+	return NULL;
+}
+
+// Wait until the flush thread has sent the frame it is working on
+// Afterwards the calling thread can use the bus until the next oledPresent()
+static void oledWaitIdle(oled_t *pOLED) {
+	if (!pOLED->bAsync)
+		return;
+	pthread_mutex_lock(&pOLED->mtxFlush);
+	while (pOLED->bFramePending)
+		pthread_cond_wait(&pOLED->cvFlush, &pOLED->mtxFlush);
+	pthread_mutex_unlock(&pOLED->mtxFlush);
+}
+
+// Start (1) or stop (0) the background flush thread
+// While it runs, drawing is deferred and oledPresent() hands each frame
+// to the thread, so rasterizing the next frame overlaps sending this one.
+// Stopping it goes back to the drawing mode it was started in; for
+// immediate mode, what was drawn since the last present is flushed.
+int oledSetAsyncCtx(oled_t *pOLED, int bAsync) {
+	int y;
+
+	if (!pOLED->bReady)
+		return -1;
+
+	if (bAsync && !pOLED->bAsync) {
+		memcpy(pOLED->ucFront, pOLED->ucScreen, pOLED->iPitch * pOLED->iPages);
+		for (y=0; y<pOLED->iPages; y++) {
+			pOLED->iFrontMin[y] = pOLED->iPitch;
+			pOLED->iFrontMax[y] = -1;
+		}
+		pOLED->bFramePending = pOLED->bFlushQuit = pOLED->iFlushError = 0;
+		if (pthread_create(&pOLED->tidFlush, NULL, oledFlushThread, pOLED) != 0)
+			return -1;
+		pOLED->bAsyncDeferred = pOLED->bDeferred;
+		pOLED->bDeferred = 1;
+		pOLED->bAsync = 1;
+	} else if (!bAsync && pOLED->bAsync) {
+		pthread_mutex_lock(&pOLED->mtxFlush);
+		pOLED->bFlushQuit = 1;
+		pthread_cond_broadcast(&pOLED->cvFlush);
+		pthread_mutex_unlock(&pOLED->mtxFlush);
+		pthread_join(pOLED->tidFlush, NULL);
+		pOLED->bAsync = 0;
+		if (!pOLED->bAsyncDeferred)
+			return oledSetDeferredCtx(pOLED, 0);
+	}
+	return 0;
+}
+
+// Hand the current frame to the flush thread and return right away
+// Waits only if the previous frame is still being sent. The changed spans
+// are copied to the front buffer, so the application keeps drawing on top
+// of the frame it just presented.
+// Returns the result of the previously sent frame
+// Without the flush thread this is the same as oledFlush()
+int oledPresentCtx(oled_t *pOLED) {
+	int y, iLen, rc;
+
+	if (!pOLED->bReady)
+		return -1;
+	if (!pOLED->bAsync)
+		return oledFlushCtx(pOLED);
+
+	oledWaitIdle(pOLED);
+	for (y=0; y<pOLED->iPages; y++) {	// added to spans a hardware scroll held back
+		iLen = pOLED->iDirtyMax[y] - pOLED->iDirtyMin[y] + 1;
+		if (iLen <= 0)
+			continue;
+		memcpy(&pOLED->ucFront[y*pOLED->iPitch + pOLED->iDirtyMin[y]], &pOLED->ucScreen[y*pOLED->iPitch + pOLED->iDirtyMin[y]], iLen);
+		if (pOLED->iDirtyMin[y] < pOLED->iFrontMin[y])
+			pOLED->iFrontMin[y] = pOLED->iDirtyMin[y];
+		if (pOLED->iDirtyMax[y] > pOLED->iFrontMax[y])
+			pOLED->iFrontMax[y] = pOLED->iDirtyMax[y];
+	}
+	oledClearDirty(pOLED);
+	pthread_mutex_lock(&pOLED->mtxFlush);
+	rc = pOLED->iFlushError; // the thread may start on the new frame at once
+	pOLED->bFramePending = 1;
+	pthread_cond_broadcast(&pOLED->cvFlush);
+	pthread_mutex_unlock(&pOLED->mtxFlush);
+	return rc;
+}
+
+// Flush a list of displays one after the other
+static int oledFlushList(oled_t **ppOLED, int iCount) {
+	int i, rc = 0;
+
+	for (i=0; i<iCount; i++) {
+		if (oledFlushCtx(ppOLED[i]) != 0)
+			rc = -1;
+	}
+	return rc;
+}
+
+// Bus worker: flush each job handed over by oledFlushMany()
+static void *oledBusThread(void *pArg) {
+	OLEDBUS *pBus = pArg;
+	OLEDJOB *pJob;
+	int rc;
+
+	pthread_mutex_lock(&pBus->mtxJob);
+	for (;;) {
+		while (pBus->pJob == NULL || pBus->pJob->bDone)
+			pthread_cond_wait(&pBus->cvJob, &pBus->mtxJob);
+		pJob = pBus->pJob;
+		pthread_mutex_unlock(&pBus->mtxJob);
+		rc = oledFlushList(pJob->ppOLED, pJob->iCount);
+		pthread_mutex_lock(&pBus->mtxJob);
+		pJob->iError = rc;
+		pJob->bDone = 1;
+		pBus->pJob = NULL;
+		pthread_cond_broadcast(&pBus->cvJob);
+	}
+	return NULL;
+}
+
+// Flush several displays, those on different buses at the same time
+// Each bus gets a persistent worker thread; the displays on one bus are
+// flushed in turn by it, and the calling thread takes one bus itself.
+// Returns 0 if every display was flushed, -1 otherwise
+int oledFlushMany(oled_t **ppOLED, int iCount) {
+	oled_t **ppSorted;
+	OLEDJOB jobs[OLED_MAX_BUSES];
+	int iStart[OLED_MAX_BUSES+1];
+	int i, b, iSelf = -1, rc = 0;
+
+	if (iCount <= 0)
+		return 0;
+	ppSorted = malloc(iCount * sizeof(oled_t *));
+	if (ppSorted == NULL)
+		return -1;
+
+	// Group the displays by bus (counting sort)
+	// A video wall has no bus; flushing it flushes its panels in parallel
+	memset(iStart, 0, sizeof(iStart));
+	for (i=0; i<iCount; i++) {
+		if (!ppOLED[i]->bReady) {
+			rc = -1;
+			continue;
+		}
+		if (ppOLED[i]->ppPanels) {
+			if (oledFlushCtx(ppOLED[i]) != 0)
+				rc = -1;
+			continue;
+		}
+		iStart[ppOLED[i]->pBus - oledBuses + 1]++;
+	}
+	for (b=0; b<OLED_MAX_BUSES; b++)
+		iStart[b+1] += iStart[b];
+	memset(jobs, 0, sizeof(jobs));
+	for (i=0; i<iCount; i++) {
+		if (!ppOLED[i]->bReady || ppOLED[i]->ppPanels)
+			continue;
+		b = ppOLED[i]->pBus - oledBuses;
+		ppSorted[iStart[b] + jobs[b].iCount++] = ppOLED[i];
+	}
+
+	// Hand every bus but one to its worker
+	for (b=0; b<OLED_MAX_BUSES; b++) {
+		OLEDBUS *pBus = &oledBuses[b];
+		if (jobs[b].iCount == 0)
+			continue;
+		jobs[b].ppOLED = &ppSorted[iStart[b]];
+		if (iSelf < 0) {
+			iSelf = b;
+			continue;
+		}
+		pthread_mutex_lock(&pBus->mtxJob);
+		if (!pBus->bWorker) {
+			pthread_t tid;
+			if (pthread_create(&tid, NULL, oledBusThread, pBus) == 0) {
+				pthread_detach(tid);
+				pBus->bWorker = 1;
+			}
+		}
+		if (pBus->bWorker) {
+			while (pBus->pJob != NULL) // busy with another caller's job
+				pthread_cond_wait(&pBus->cvJob, &pBus->mtxJob);
+			pBus->pJob = &jobs[b];
+			pthread_cond_broadcast(&pBus->cvJob);
+		} else {	// no thread, flush it here
+			jobs[b].iError = oledFlushList(jobs[b].ppOLED, jobs[b].iCount);
+			jobs[b].bDone = 1;
+		}
+		pthread_mutex_unlock(&pBus->mtxJob);
+	}
+	if (iSelf >= 0) {
+		jobs[iSelf].iError = oledFlushList(jobs[iSelf].ppOLED, jobs[iSelf].iCount);
+		jobs[iSelf].bDone = 1;
+	}
+
+	// Wait for the workers
+	for (b=0; b<OLED_MAX_BUSES; b++) {
+		OLEDBUS *pBus = &oledBuses[b];
+		if (jobs[b].iCount == 0)
+			continue;
+		pthread_mutex_lock(&pBus->mtxJob);
+		while (!jobs[b].bDone)
+			pthread_cond_wait(&pBus->cvJob, &pBus->mtxJob);
+		pthread_mutex_unlock(&pBus->mtxJob);
+		if (jobs[b].iError)
+			rc = -1;
+	}
+	free(ppSorted);
+	return rc;
+}
 //
-// Draw a string of small (8x8), large (16x24), or very small (6x8)  characters
+// Draw a string of small (8x8), large (16x32), or very small (6x8)  characters
 // At the given col+row
 // The X position is in character widths (8 or 16)
 // The Y position is in memory pages (8 lines each)
+// Each page row of the string is sent as one data burst after a single
+// position command, e.g. 4 bursts for a line of FONT_BIG digits.
+// Text that crosses the clip rectangle is drawn glyph by glyph instead.
 //
-int oledWriteString(int x, int y, char *szMsg, int iSize) {
-	int i, iLen;
-	unsigned char *s;
+int oledWriteStringCtx(oled_t *pOLED, int x, int y, char *szMsg, int iSize) {
+	int i, k, iLen, iWidth, iPages, iChunk;
+	unsigned char *s, ucRow[128];
 
-	if (file_i2c == 0)
+	if (!pOLED->bReady)
 		return -1; // not initialized
 	if (iSize < FONT_NORMAL || iSize > FONT_SMALL)
 		return -1;
+	if (x < 0 || y < 0 || y >= oledPageCount(pOLED))
+		return -1; // off the screen
 
+	iWidth = (iSize == FONT_BIG) ? 16 : ((iSize == FONT_SMALL) ? 6 : 8);
+	iPages = (iSize == FONT_BIG) ? 4 : 1; // 16x32 glyphs are 4 pages tall
 	iLen = strlen(szMsg);
-	if (iSize == FONT_BIG) {	// draw 16x32 font
-		if (iLen+x > 8) iLen = 8-x;
-		if (iLen < 0) return -1;
-		x *= 16;
+	if (iLen + x > oledColumnCount(pOLED)/iWidth) iLen = oledColumnCount(pOLED)/iWidth - x; // can't display it
+	if (iLen < 0) return -1;
+	k = (y + iPages < oledPageCount(pOLED)) ? y + iPages : oledPageCount(pOLED);
+	if (x*iWidth < pOLED->iClipX0 || (x + iLen)*iWidth - 1 > pOLED->iClipX1 ||
+	    y*8 < pOLED->iClipY0 || k*8 - 1 > pOLED->iClipY1) {	// clipped: draw the glyphs like oledDrawString()
 		for (i=0; i<iLen; i++) {
-			s = &ucFont[9728 + (unsigned char)szMsg[i]*64];
-			oledSetPosition(x+(i*16), y);
-			oledWriteDataBlock(s, 16);
-			oledSetPosition(x+(i*16), y+1);
-			oledWriteDataBlock(s+16, 16);	
-			oledSetPosition(x+(i*16), y+2);
-			oledWriteDataBlock(s+32, 16);	
-//			oledSetPosition(x+(i*16), y+3);
-//			oledWriteDataBlock(s+48, 16);	
+			if (oledClipReject(pOLED, (x+i)*iWidth, y*8, (x+i+1)*iWidth - 1, (y+iPages)*8 - 1))
+				continue;
+			if (iSize == FONT_BIG)
+				oledBlitPages(pOLED, &ucFont[9728 + (unsigned char)szMsg[i]*64], 16, 16, 32, (x+i)*16, y*8, OLED_ROP_COPY);
+			else if (iSize == FONT_NORMAL)
+				oledBlitPages(pOLED, &ucFont[(unsigned char)szMsg[i]*8], 8, 8, 8, (x+i)*8, y*8, OLED_ROP_COPY);
+			else
+				oledBlitPages(pOLED, &ucSmallFont[(unsigned char)szMsg[i]*6], 6, 6, 8, (x+i)*6, y*8, OLED_ROP_COPY);
 		}
-	} else if (iSize == FONT_NORMAL) {	// draw 8x8 font
-		oledSetPosition(x*8, y);
-		if (iLen + x > 16) iLen = 16 - x; // can't display it
-		if (iLen < 0)return -1;
+		return oledUpdate(pOLED);
+	}
+	iChunk = sizeof(ucRow) / iWidth; // glyphs per burst, more only on a wall
 
-		for (i=0; i<iLen; i++)
-		{
-			s = &ucFont[(unsigned char)szMsg[i] * 8];
-			oledWriteDataBlock(s, 8); // write character pattern
-		}	
-	} else {	// 6x8
-		oledSetPosition(x*6, y);
-		if (iLen + x > 21) iLen = 21 - x;
-		if (iLen < 0) return -1;
-		for (i=0; i<iLen; i++)
-		{
-			s = &ucSmallFont[(unsigned char)szMsg[i]*6];
-			oledWriteDataBlock(s, 6);
+	for (k=0; k<iPages && y+k < oledPageCount(pOLED); k++) {
+		oledSetPosition(pOLED, x*iWidth, y+k);
+		for (i=0; i<iLen; i++) {
+			if (iSize == FONT_BIG)
+				s = &ucFont[9728 + (unsigned char)szMsg[i]*64 + k*16];
+			else if (iSize == FONT_NORMAL)
+				s = &ucFont[(unsigned char)szMsg[i] * 8];
+			else
+				s = &ucSmallFont[(unsigned char)szMsg[i]*6];
+			memcpy(&ucRow[(i % iChunk)*iWidth], s, iWidth);
+			if (i % iChunk == iChunk-1 || i == iLen-1)
+				oledWriteDataBlock(pOLED, ucRow, (i % iChunk + 1)*iWidth);
 		}
 	}
-	return 0;
+	if (pOLED->ppPanels)
+		return oledUpdate(pOLED);
+	if (pOLED->bDeferred || pOLED->bScrolling)
+		return 0; // nothing was queued, and the flush thread may be using the queue
+	return oledCommit(pOLED);
 }
 
 // Fill the frame buffer with a byte pattern
 // e.g. all off (0x00) or all on (0xff)
-int oledFill(unsigned char ucData) {
+int oledFillCtx(oled_t *pOLED, unsigned char ucData) {
 	int y;
-	unsigned char temp[128];
 	int iLines, iCols;
 
-	if (file_i2c == 0)
+	if (!pOLED->bReady)
 		return -1; // not initialized
 
-	iLines = (oled_type == OLED_128x32 || oled_type == OLED_64x32) ? 4:8;
-	iCols = (oled_type == OLED_64x32) ? 4:8;
+	iLines = oledPageCount(pOLED);
+	iCols = oledColumnCount(pOLED);
 
-	memset(temp, ucData, 128);
 	for (y=0; y<iLines; y++) {
-		oledSetPosition(0,y); // set to (0,Y)
-		oledWriteDataBlock(temp, iCols*16); // fill with data byte
+		memset(&pOLED->ucScreen[y*pOLED->iPitch], ucData, iCols); // fill with data byte
+		oledMarkDirty(pOLED, y, 0, iCols-1);
 	} // for y
-	return 0;
+	return oledUpdate(pOLED); // whole frame in one transaction
 } /* oledFill() */
 
 // Draw a line of text using varaible arguments like printf().
-int oledPrintf(int x, int y, char *szMsg, int iSize, ...) {
-	va_list args;
+static int oledVPrintf(oled_t *pOLED, int x, int y, char *szMsg, int iSize, va_list args) {
 	char buf[2048];
 
-	va_start(args, iSize);
-
 	int r = vsprintf(buf, szMsg, args);
 
-	oledWriteString(x, y, buf, iSize);
+	oledWriteStringCtx(pOLED, x, y, buf, iSize);
+
+	return r;
+}
+
+int oledPrintfCtx(oled_t *pOLED, int x, int y, char *szMsg, int iSize, ...) {
+	va_list args;
 
+	va_start(args, iSize);
+	int r = oledVPrintf(pOLED, x, y, szMsg, iSize, args);
 	va_end(args);
 
-	return r;	
+	return r;
+}
+
+// Scroll the console up iLines pages
+// On a single display the display start line moves down instead of
+// the whole screen being rewritten: the local copy and its dirty spans
+// are rotated to match, so only the cleared bottom pages are sent.
+// A video wall or a display with a flush thread is repainted.
+static void oledConsoleScroll(oled_t *pOLED, int iLines) {
+	int y, iPages, iCols;
+
+	iPages = oledPageCount(pOLED);
+	iCols = oledColumnCount(pOLED);
+	memmove(pOLED->ucScreen, &pOLED->ucScreen[iLines*pOLED->iPitch], (iPages - iLines)*pOLED->iPitch);
+	memset(&pOLED->ucScreen[(iPages - iLines)*pOLED->iPitch], 0, iLines*pOLED->iPitch);
+	if (pOLED->ppPanels || pOLED->bAsync) {	// the start line can't follow
+		for (y=0; y<iPages; y++)
+			oledMarkDirty(pOLED, y, 0, iCols-1);
+		return;
+	}
+	for (y=0; y<iPages - iLines; y++) {
+		pOLED->iDirtyMin[y] = pOLED->iDirtyMin[y + iLines];
+		pOLED->iDirtyMax[y] = pOLED->iDirtyMax[y + iLines];
+	}
+	for (; y<iPages; y++) {	// display memory still has the old top lines
+		pOLED->iDirtyMin[y] = 0;
+		pOLED->iDirtyMax[y] = iCols-1;
+	}
+	memmove(pOLED->ucShown, &pOLED->ucShown[iLines*pOLED->iPitch], (iPages - iLines)*pOLED->iPitch);
+	pOLED->iShownValid = (pOLED->iShownValid >> iLines) & ((1 << (iPages - iLines)) - 1);
+	pOLED->iStartPage = (pOLED->iStartPage + iLines) & 7;
+	pOLED->bCursorValid = 0;
+}
+
+// Clear the screen for the console and put its cursor in the top left
+// corner; iSize is the font of the console text
+int oledConsoleClearCtx(oled_t *pOLED, int iSize) {
+	if (!pOLED->bReady)
+		return -1;
+	if (iSize < FONT_NORMAL || iSize > FONT_SMALL)
+		return -1;
+	pOLED->iConFont = iSize;
+	pOLED->iConX = pOLED->iConY = 0;
+	return oledFillCtx(pOLED, 0);
+}
+
+// Write text at the console cursor like a terminal
+// '\n' starts a new line and '\r' goes back to the start of the line;
+// text wraps at the right edge and the screen scrolls up when the cursor
+// moves past the bottom. The changes are sent in one transaction.
+int oledConsolePutsCtx(oled_t *pOLED, char *szMsg) {
+	int iLen, iCols, iLines, bDeferred;
+	char szRun[129];
+
+	if (!pOLED->bReady)
+		return -1;
+	iCols = oledColumnCount(pOLED) / ((pOLED->iConFont == FONT_BIG) ? 16 : ((pOLED->iConFont == FONT_SMALL) ? 6 : 8));
+	iLines = (pOLED->iConFont == FONT_BIG) ? 4 : 1; // pages per text line
+	if (iLines > oledPageCount(pOLED))
+		return -1;
+	bDeferred = pOLED->bDeferred;
+	pOLED->bDeferred = 1; // draw it all, then send once
+	for (iLen=0;; szMsg++) {
+		if (iLen && (*szMsg == 0 || *szMsg == '\n' || *szMsg == '\r' ||
+		    pOLED->iConX + iLen == iCols || iLen == sizeof(szRun)-1)) {	// write the run
+			szRun[iLen] = 0;
+			oledWriteStringCtx(pOLED, pOLED->iConX, pOLED->iConY, szRun, pOLED->iConFont);
+			pOLED->iConX += iLen;
+			iLen = 0;
+		}
+		if (*szMsg == 0)
+			break;
+		if (*szMsg == '\r') {
+			pOLED->iConX = 0;
+			continue;
+		}
+		if (*szMsg == '\n' || pOLED->iConX == iCols) {	// next line
+			pOLED->iConX = 0;
+			pOLED->iConY += iLines;
+			if (pOLED->iConY + iLines > oledPageCount(pOLED)) {
+				oledConsoleScroll(pOLED, iLines);
+				pOLED->iConY -= iLines;
+			}
+			if (*szMsg == '\n')
+				continue;
+		}
+		szRun[iLen++] = *szMsg;
+	}
+	pOLED->bDeferred = bDeferred;
+	return oledUpdate(pOLED);
+}
+
+// Draw a string at any pixel position (x,y) = top left of the first glyph
+// Glyphs go into the local copy like the other shapes: with
+// OLED_TEXT_TRANSPARENT only the set pixels of the glyph are drawn,
+// OLED_TEXT_OPAQUE replaces the whole glyph cell and OLED_TEXT_XOR inverts
+// the pixels under the set ones.
+int oledDrawStringCtx(oled_t *pOLED, int x, int y, char *szMsg, int iSize, int iMode) {
+	int i, iLen, iWidth, iRop;
+	unsigned char *s;
+	static const unsigned char ucRops[] = {OLED_ROP_OR, OLED_ROP_COPY, OLED_ROP_XOR};
+
+	if (!pOLED->bReady)
+		return -1; // not initialized
+	if (iSize < FONT_NORMAL || iSize > FONT_SMALL)
+		return -1;
+	if (iMode < OLED_TEXT_TRANSPARENT || iMode > OLED_TEXT_XOR)
+		return -1;
+	iRop = ucRops[iMode];
+
+	iLen = strlen(szMsg);
+	iWidth = (iSize == FONT_BIG) ? 16 : ((iSize == FONT_SMALL) ? 6 : 8);
+	for (i=0; i<iLen && x <= pOLED->iClipX1; i++, x += iWidth) {
+		if (x + iWidth <= pOLED->iClipX0)
+			continue; // left of the clip rectangle
+		if (iSize == FONT_BIG) {
+			s = &ucFont[9728 + (unsigned char)szMsg[i]*64];
+			oledBlitPages(pOLED, s, 16, 16, 32, x, y, iRop);
+		} else if (iSize == FONT_NORMAL) {
+			s = &ucFont[(unsigned char)szMsg[i] * 8];
+			oledBlitPages(pOLED, s, 8, 8, 8, x, y, iRop);
+		} else {
+			s = &ucSmallFont[(unsigned char)szMsg[i]*6];
+			oledBlitPages(pOLED, s, 6, 6, 8, x, y, iRop);
+		}
+	}
+	return oledUpdate(pOLED);
+}
+
+// Draw a w x h bitmap at any pixel position (x,y) with a raster op
+// The bitmap is in the display's own page-major format: w bytes for each
+// 8 rows, LSB on top, the way ucScreen and the fonts are stored.
+int oledBlitCtx(oled_t *pOLED, int x, int y, unsigned char *pBitmap, int w, int h, int iRop) {
+
+	if (!pOLED->bReady)
+		return -1;
+	if (w < 0 || h < 0 || iRop < OLED_ROP_COPY || iRop > OLED_ROP_NOT)
+		return -1;
+	if (w == 0 || h == 0 || oledClipReject(pOLED, x, y, x + w - 1, y + h - 1))
+		return 0;
+	oledBlitPages(pOLED, pBitmap, w, w, h, x, y, iRop);
+	return oledUpdate(pOLED);
+}
+
+// Transpose an 8x8 bit block: byte r bit j becomes byte j bit r
+static uint64_t oledTranspose8(uint64_t x) {
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x ^= t ^ (t << 28);
+	return x;
+}
+
+// Draw a w x h bitmap stored row by row, (w+7)/8 bytes per row with the
+// MSB as the leftmost pixel (the usual icon / PBM layout)
+// Each 8x8 block is turned into 8 page-major columns with one 64-bit
+// transpose; a strip of up to 64 columns is then blitted like a page.
+int oledBlitRowsCtx(oled_t *pOLED, int x, int y, unsigned char *pBitmap, int w, int h, int iRop) {
+	int sp, cx, r, c, iRows, iPitch;
+	uint64_t ullBlock;
+	unsigned char ucStrip[64];
+
+	if (!pOLED->bReady)
+		return -1;
+	if (w < 0 || h < 0 || iRop < OLED_ROP_COPY || iRop > OLED_ROP_NOT)
+		return -1;
+	if (w == 0 || h == 0 || oledClipReject(pOLED, x, y, x + w - 1, y + h - 1))
+		return 0;
+
+	iPitch = (w + 7) >> 3;
+	for (sp=0; sp*8 < h; sp++) {
+		if (oledClipReject(pOLED, x, y + sp*8, x + w - 1, y + sp*8 + 7))
+			continue; // this strip is clipped away
+		iRows = (h - sp*8 < 8) ? h - sp*8 : 8;
+		for (cx=0; cx<w; cx+=64) {
+			if (oledClipReject(pOLED, x + cx, y + sp*8, x + cx + 63, y + sp*8 + 7))
+				continue;
+			for (c=cx; c<cx+64 && c<w; c+=8) {
+				ullBlock = 0;
+				for (r=0; r<iRows; r++)
+					ullBlock |= (uint64_t)pBitmap[(sp*8 + r)*iPitch + (c >> 3)] << (r*8);
+				ullBlock = oledTranspose8(ullBlock); // byte 7-k = column k
+				for (r=0; r<8; r++)
+					ucStrip[c - cx + r] = (unsigned char)(ullBlock >> ((7 - r)*8));
+			}
+			oledBlitPages(pOLED, ucStrip, 64, (w - cx < 64) ? w - cx : 64, iRows, x + cx, y + sp*8, iRop);
+		}
+	}
+	return oledUpdate(pOLED);
+}
+
+// Nonzero if sprite pS overlaps the w x h box at (x,y)
+static int oledSpriteHits(OLEDSPRITE *pS, int x, int y, int w, int h) {
+	return (pS->bVisible && w > 0 && h > 0 && pS->x < x + w && x < pS->x + pS->w &&
+		pS->y < y + h && y < pS->y + pS->h);
+}
+
+// Put back the pixels a sprite covers
+// Only the bits inside its box are restored, so sprites that share a page
+// without overlapping don't disturb each other
+static void oledSpriteRestore(oled_t *pOLED, OLEDSPRITE *pS) {
+	int p, iTop, iBot;
+	unsigned char ucMask;
+
+	for (p=pS->iSaveY0 >> 3; pS->iSaveX0 <= pS->iSaveX1 && p<=pS->iSaveY1 >> 3; p++) {
+		iTop = (p*8 > pS->iSaveY0) ? 0 : pS->iSaveY0 & 7;
+		iBot = (p*8 + 7 < pS->iSaveY1) ? 7 : pS->iSaveY1 & 7;
+		ucMask = (0xff << iTop) & (0xff >> (7 - iBot));
+		oledMaskBytes(&pOLED->ucScreen[p*pOLED->iPitch + pS->iSaveX0], &pS->ucSave[(p - (pS->iSaveY0 >> 3))*OLED_SPRITE_SIZE],
+			pS->iSaveX1 - pS->iSaveX0 + 1, 0, 0xff, ucMask, OLED_ROP_COPY);
+		oledMarkDirty(pOLED, p, pS->iSaveX0, pS->iSaveX1);
+	}
+}
+
+// Save the pixels under a sprite and draw it: clear its mask, then OR
+// in its bitmap
+// Sprites sit above the clip rectangle; they are only clipped to the screen
+static void oledSpriteDraw(oled_t *pOLED, OLEDSPRITE *pS) {
+	int p, iClip[4];
+
+	pS->iSaveX0 = (pS->x > 0) ? pS->x : 0;
+	pS->iSaveY0 = (pS->y > 0) ? pS->y : 0;
+	pS->iSaveX1 = (pS->x + pS->w - 1 < oledColumnCount(pOLED) - 1) ? pS->x + pS->w - 1 : oledColumnCount(pOLED) - 1;
+	pS->iSaveY1 = (pS->y + pS->h - 1 < oledPageCount(pOLED)*8 - 1) ? pS->y + pS->h - 1 : oledPageCount(pOLED)*8 - 1;
+	if (pS->iSaveY0 > pS->iSaveY1)
+		pS->iSaveX1 = pS->iSaveX0 - 1; // off the screen, nothing saved
+	for (p=pS->iSaveY0 >> 3; pS->iSaveX0 <= pS->iSaveX1 && p<=pS->iSaveY1 >> 3; p++)
+		memcpy(&pS->ucSave[(p - (pS->iSaveY0 >> 3))*OLED_SPRITE_SIZE], &pOLED->ucScreen[p*pOLED->iPitch + pS->iSaveX0],
+			pS->iSaveX1 - pS->iSaveX0 + 1);
+	iClip[0] = pOLED->iClipX0; iClip[1] = pOLED->iClipY0;
+	iClip[2] = pOLED->iClipX1; iClip[3] = pOLED->iClipY1;
+	oledResetClipCtx(pOLED);
+	oledBlitPages(pOLED, pS->ucHole, pS->w, pS->w, pS->h, pS->x, pS->y, OLED_ROP_AND);
+	oledBlitPages(pOLED, pS->ucImage, pS->w, pS->w, pS->h, pS->x, pS->y, OLED_ROP_OR);
+	pOLED->iClipX0 = iClip[0]; pOLED->iClipY0 = iClip[1];
+	pOLED->iClipX1 = iClip[2]; pOLED->iClipY1 = iClip[3];
+}
+
+// Take down sprite iSprite before it changes to the w x h box at (x,y)
+// Sprites above it that overlap its old or new box, or a sprite taken
+// down before them, must come off first (top down) since their saved
+// pixels include it. ucPeeled lists the sprites to put back afterwards.
+static void oledSpritePeel(oled_t *pOLED, int iSprite, int x, int y, int w, int h, unsigned char *ucPeeled) {
+	int i, j;
+	OLEDSPRITE *pS;
+
+	memset(ucPeeled, 0, OLED_MAX_SPRITES);
+	ucPeeled[iSprite] = 1;
+	for (j=iSprite+1; j<OLED_MAX_SPRITES; j++) {
+		pS = &pOLED->sprites[j];
+		ucPeeled[j] = oledSpriteHits(pS, x, y, w, h);
+		for (i=iSprite; i<j && !ucPeeled[j]; i++)
+			if (ucPeeled[i])
+				ucPeeled[j] = oledSpriteHits(pS, pOLED->sprites[i].x, pOLED->sprites[i].y, pOLED->sprites[i].w, pOLED->sprites[i].h) &&
+					pOLED->sprites[i].bVisible;
+	}
+	for (j=OLED_MAX_SPRITES-1; j>=iSprite; j--)
+		if (ucPeeled[j] && pOLED->sprites[j].bVisible)
+			oledSpriteRestore(pOLED, &pOLED->sprites[j]);
+}
+
+// Put the peeled sprites back, bottom up, and send the changes
+// Only their old and new boxes were marked dirty
+static int oledSpriteStack(oled_t *pOLED, int iSprite, unsigned char *ucPeeled) {
+	int j;
+
+	for (j=iSprite; j<OLED_MAX_SPRITES; j++)
+		if (ucPeeled[j] && pOLED->sprites[j].bVisible)
+			oledSpriteDraw(pOLED, &pOLED->sprites[j]);
+	return oledUpdate(pOLED);
+}
+
+// Give sprite iSprite a w x h bitmap (at most 32x32) and mask, both in
+// page-major format like oledBlit(); where the mask is clear the screen
+// shows through. A NULL mask makes the whole box opaque.
+// The data is copied, so the caller's buffers can be reused.
+int oledSpriteSetCtx(oled_t *pOLED, int iSprite, unsigned char *pBitmap, unsigned char *pMask, int w, int h) {
+	int i;
+	unsigned char ucPeeled[OLED_MAX_SPRITES];
+	OLEDSPRITE *pS;
+
+	if (!pOLED->bReady)
+		return -1;
+	if (iSprite < 0 || iSprite >= OLED_MAX_SPRITES || w < 1 || h < 1 || w > OLED_SPRITE_SIZE || h > OLED_SPRITE_SIZE)
+		return -1;
+	pS = &pOLED->sprites[iSprite];
+	oledSpritePeel(pOLED, iSprite, pS->x, pS->y, w, h, ucPeeled);
+	pS->w = w;
+	pS->h = h;
+	for (i=0; i<w*((h + 7) >> 3); i++) {
+		pS->ucHole[i] = pMask ? ~pMask[i] : 0;
+		pS->ucImage[i] = pBitmap[i] & ~pS->ucHole[i];
+	}
+	return oledSpriteStack(pOLED, iSprite, ucPeeled);
+}
+
+// Show sprite iSprite with its top left corner at (x,y)
+// The pixels it covered before are put back, so only its old and new
+// boxes are sent to the display.
+int oledSpriteMoveCtx(oled_t *pOLED, int iSprite, int x, int y) {
+	unsigned char ucPeeled[OLED_MAX_SPRITES];
+	OLEDSPRITE *pS;
+
+	if (!pOLED->bReady)
+		return -1;
+	if (iSprite < 0 || iSprite >= OLED_MAX_SPRITES || pOLED->sprites[iSprite].w == 0)
+		return -1;
+	pS = &pOLED->sprites[iSprite];
+	if (pS->bVisible && pS->x == x && pS->y == y)
+		return 0; // already there
+	oledSpritePeel(pOLED, iSprite, x, y, pS->w, pS->h, ucPeeled);
+	pS->x = x;
+	pS->y = y;
+	pS->bVisible = 1;
+	return oledSpriteStack(pOLED, iSprite, ucPeeled);
+}
+
+// Take sprite iSprite off the screen
+int oledSpriteHideCtx(oled_t *pOLED, int iSprite) {
+	unsigned char ucPeeled[OLED_MAX_SPRITES];
+
+	if (!pOLED->bReady)
+		return -1;
+	if (iSprite < 0 || iSprite >= OLED_MAX_SPRITES)
+		return -1;
+	if (!pOLED->sprites[iSprite].bVisible)
+		return 0;
+	oledSpritePeel(pOLED, iSprite, 0, 0, 0, 0, ucPeeled);
+	pOLED->sprites[iSprite].bVisible = 0;
+	return oledSpriteStack(pOLED, iSprite, ucPeeled);
 }
 
 // Draw a circle.
-int oledCircle(int xc, int yc, int r, unsigned char color) {
+int oledCircleCtx(oled_t *pOLED, int xc, int yc, int r, unsigned char color) {
+
+	if (!pOLED->bReady)
+		return -1;
+	if (r < 0 || oledClipReject(pOLED, xc - r, yc - r, xc + r, yc + r))
+		return 0;
 
 	int x = 0;
     int y = r;
@@ -303,14 +1935,14 @@ int oledCircle(int xc, int yc, int r, unsigned char color) {
 
     while (y >= x)
     {
-        oledSetPixel(xc + x, yc + y, color);
-        oledSetPixel(xc - x, yc + y, color);
-        oledSetPixel(xc + x, yc - y, color);
-        oledSetPixel(xc - x, yc - y, color);
-        oledSetPixel(xc + y, yc + x, color);
-        oledSetPixel(xc - y, yc + x, color);
-        oledSetPixel(xc + y, yc - x, color);
-        oledSetPixel(xc - y, yc - x, color);
+        oledPlot(pOLED, xc + x, yc + y, color);
+        oledPlot(pOLED, xc - x, yc + y, color);
+        oledPlot(pOLED, xc + x, yc - y, color);
+        oledPlot(pOLED, xc - x, yc - y, color);
+        oledPlot(pOLED, xc + y, yc + x, color);
+        oledPlot(pOLED, xc - y, yc + x, color);
+        oledPlot(pOLED, xc + y, yc - x, color);
+        oledPlot(pOLED, xc - y, yc - x, color);
 
         x++;
 
@@ -321,6 +1953,7 @@ int oledCircle(int xc, int yc, int r, unsigned char color) {
             d = d + 4 * x + 6;
         }
     }
+	oledUpdate(pOLED);
 
 	return 0;
 }
@@ -328,79 +1961,81 @@ int oledCircle(int xc, int yc, int r, unsigned char color) {
 // -----------------------------------------------------------
 // Draw a horizontal line
 // -----------------------------------------------------------
-void oledHLine(int x, int y, int length, unsigned char color)
+int oledHLineCtx(oled_t *pOLED, int x, int y, int length, unsigned char color)
 {
-    for (int i = 0; i < length; i++)
-        oledSetPixel(x + i, y, color);
+    if (!pOLED->bReady)
+        return -1;
+    if (length > 0) {
+        oledHSpan(pOLED, x, x + length - 1, y, color);
+        oledUpdate(pOLED);
+    }
+    return 0;
 }
 
 // -----------------------------------------------------------
 // Draw a vertical line
 // -----------------------------------------------------------
-void oledVLine(int x, int y, int length, unsigned char color)
+int oledVLineCtx(oled_t *pOLED, int x, int y, int length, unsigned char color)
 {
-    for (int i = 0; i < length; i++)
-        oledSetPixel(x, y + i, color);
+    if (!pOLED->bReady)
+        return -1;
+    if (length > 0) {
+        oledVSpan(pOLED, x, y, y + length - 1, color);
+        oledUpdate(pOLED);
+    }
+    return 0;
 }
 
-int oledFilledCircle(int xc, int yc, int r, unsigned char color) {
-
-	for (int y = yc - r; y <= yc + r; y++) {
-        for (int x = xc - r; x <= xc + r; x++) {
-            int dx = x - xc;
-            int dy = y - yc;
-            if (dx*dx + dy*dy <= r*r)
-                oledSetPixel(x, y, color);
-        }
-    }
+int oledFilledCircleCtx(oled_t *pOLED, int xc, int yc, int r, unsigned char color) {
 
-	return 0;
+	return oledFilledEllipseCtx(pOLED, xc, yc, r, r, color);
 }
 
 // Draw square.
-int oledSquare(int x, int y, int size, unsigned char color) {
+int oledSquareCtx(oled_t *pOLED, int x, int y, int size, unsigned char color) {
 
-	oledHLine(x, y, size, color);              // top
-    oledHLine(x, y + size - 1, size, color);   // bottom
-    oledVLine(x, y, size, color);              // left
-    oledVLine(x + size - 1, y, size, color);   // right
-	
-	return 0;
+	return oledRectangleCtx(pOLED, x, y, size, size, color);
 }
 
-int oledFilledSquare(int x, int y, int size, unsigned char color) {
-
-	for (int i = 0; i < size; i++) {
-        for (int j = 0; j < size; j++) {
-            oledSetPixel(x + i, y + j, color);
-        }
-    }
+int oledFilledSquareCtx(oled_t *pOLED, int x, int y, int size, unsigned char color) {
 
-	return 0;
+	return oledFilledRectangleCtx(pOLED, x, y, size, size, color);
 }
 
-int oledRectangle(int x, int y, int width, int height, unsigned char color) {
+int oledRectangleCtx(oled_t *pOLED, int x, int y, int width, int height, unsigned char color) {
+
+	if (!pOLED->bReady)
+		return -1;
+	if (width <= 0 || height <= 0)
+		return 0;
+
+	oledHSpan(pOLED, x, x + width - 1, y, color);                // top
+    oledHSpan(pOLED, x, x + width - 1, y + height - 1, color);   // bottom
+    oledVSpan(pOLED, x, y, y + height - 1, color);               // left
+    oledVSpan(pOLED, x + width - 1, y, y + height - 1, color);   // right
+	oledUpdate(pOLED);
 
-	oledHLine(x, y, width, color);             // top
-    oledHLine(x, y + height - 1, width, color); // bottom
-    oledVLine(x, y, height, color);           // left
-    oledVLine(x + width - 1, y, height, color); // right
-	
 	return 0;
 }
 
-int oledFilledRectangle(int x, int y, int width, int height, unsigned char color) {
-	for (int i = 0; i < width; i++) {
-        for (int j = 0; j < height; j++) {
-            oledSetPixel(x + i, y + j, color);
-        }
-    }
+int oledFilledRectangleCtx(oled_t *pOLED, int x, int y, int width, int height, unsigned char color) {
+	if (!pOLED->bReady)
+		return -1;
+	if (width <= 0 || height <= 0)
+		return 0;
 
+	oledFillRect(pOLED, x, y, x + width - 1, y + height - 1, color);
+	oledUpdate(pOLED);
 	return 0;
 }
 
 // Draw Ellipse.
-int oledEllipse(int xc, int yc, int rx, int ry, unsigned char color) {
+int oledEllipseCtx(oled_t *pOLED, int xc, int yc, int rx, int ry, unsigned char color) {
+
+	if (!pOLED->bReady)
+		return -1;
+	if (rx < 0 || ry < 0 || oledClipReject(pOLED, xc - rx - 1, yc - ry, xc + rx + 1, yc + ry))
+		return 0;
 
 	int x = 0;
     int y = ry;
@@ -416,10 +2051,10 @@ int oledEllipse(int xc, int yc, int rx, int ry, unsigned char color) {
     // Region 1
     long p = (long)(ry2 - (rx2 * ry) + (0.25 * rx2));
     while (px < py) {
-        oledSetPixel(xc + x, yc + y, color);
-        oledSetPixel(xc - x, yc + y, color);
-        oledSetPixel(xc + x, yc - y, color);
-        oledSetPixel(xc - x, yc - y, color);
+        oledPlot(pOLED, xc + x, yc + y, color);
+        oledPlot(pOLED, xc - x, yc + y, color);
+        oledPlot(pOLED, xc + x, yc - y, color);
+        oledPlot(pOLED, xc - x, yc - y, color);
 
         x++;
         px += two_ry2;
@@ -435,10 +2070,10 @@ int oledEllipse(int xc, int yc, int rx, int ry, unsigned char color) {
     // Region 2
     p = (long)(ry2 * (x + 0.5) * (x + 0.5) + rx2 * (y - 1) * (y - 1) - rx2 * ry2);
     while (y >= 0) {
-        oledSetPixel(xc + x, yc + y, color);
-        oledSetPixel(xc - x, yc + y, color);
-        oledSetPixel(xc + x, yc - y, color);
-        oledSetPixel(xc - x, yc - y, color);
+        oledPlot(pOLED, xc + x, yc + y, color);
+        oledPlot(pOLED, xc - x, yc + y, color);
+        oledPlot(pOLED, xc + x, yc - y, color);
+        oledPlot(pOLED, xc - x, yc - y, color);
 
         y--;
         py -= two_rx2;
@@ -450,48 +2085,133 @@ int oledEllipse(int xc, int yc, int rx, int ry, unsigned char color) {
             p += rx2 - py + px;
         }
     }
+	oledUpdate(pOLED);
 
 	return 0;
 }
 
-int oledFilledEllipse(int xc, int yc, int rx, int ry, unsigned char color) {
+// Fill the pixels where dx^2*ry^2 + dy^2*rx^2 <= rx^2*ry^2
+// Each column is one vertical span, so the work is byte masks per column.
+// The span half-height only shrinks as we move out from the center, so it
+// is walked down incrementally, with 64-bit terms to avoid overflow.
+int oledFilledEllipseCtx(oled_t *pOLED, int xc, int yc, int rx, int ry, unsigned char color) {
 
-	for (int y = yc - ry; y <= yc + ry; y++) {
-        for (int x = xc - rx; x <= xc + rx; x++) {
-            int dx = x - xc;
-            int dy = y - yc;
-            // Check ellipse equation
-            if ((dx*dx)*ry*ry + (dy*dy)*rx*rx <= rx*rx*ry*ry)
-                oledSetPixel(x, y, color);
-        }
+	if (!pOLED->bReady)
+		return -1;
+	if (rx < 0 || ry < 0 || oledClipReject(pOLED, xc - rx, yc - ry, xc + rx, yc + ry))
+		return 0;
+
+	long long rx2 = (long long)rx * rx;
+	long long ry2 = (long long)ry * ry;
+	long long limit = rx2 * ry2;
+	int h = ry;
+	int iLast = rx; // stop at the farther clip edge
+
+	if (pOLED->iClipX1 - xc < iLast && xc - pOLED->iClipX0 < iLast)
+		iLast = (pOLED->iClipX1 - xc > xc - pOLED->iClipX0) ? pOLED->iClipX1 - xc : xc - pOLED->iClipX0;
+
+	for (int dx = 0; dx <= iLast; dx++) {
+        long long xterm = (long long)dx * dx * ry2;
+        while (h > 0 && xterm + (long long)h * h * rx2 > limit)
+            h--;
+        oledVSpan(pOLED, xc + dx, yc - h, yc + h, color);
+        if (dx != 0)
+            oledVSpan(pOLED, xc - dx, yc - h, yc + h, color);
     }
+	oledUpdate(pOLED);
 
 	return 0;
 }
 
+// Floor of a / b for b > 0
+static long long oledFloorDiv(long long a, long long b) {
+    long long q = a / b;
+    if ((a % b) != 0 && a < 0)
+        q--;
+    return q;
+}
+
+// Draw a line into the back buffer without sending it
+// Steps along the major axis; step i lands on the minor coordinate
+// b0 + sb*floor((2*i*db + da - 1) / (2*da)), the same pixels that
+// Bresenham picks. That closed form turns the clip rectangle into a range
+// of i up front (Liang-Barsky on the pixel grid), so only the visible
+// part of the line is walked and no pixel needs a bounds check.
+static void oledDrawLine(oled_t *pOLED, int x0, int y0, int x1, int y1, unsigned char color) {
+	int bSteep, a0, b0, da, db, sa, sb, i, i0, i1, a, b;
+	int amin, amax, bmin, bmax;
+	long long num, lo, hi, r, q;
+
+	if (y0 == y1) {	// axis aligned, use the span kernels
+		oledHSpan(pOLED, (x0 < x1) ? x0 : x1, (x0 < x1) ? x1 : x0, y0, color);
+		return;
+	}
+	if (x0 == x1) {
+		oledVSpan(pOLED, x0, (y0 < y1) ? y0 : y1, (y0 < y1) ? y1 : y0, color);
+		return;
+	}
+
+	bSteep = (abs(y1 - y0) > abs(x1 - x0));
+	if (bSteep) {	// walk y, with x as the minor axis
+		a0 = y0; b0 = x0; da = abs(y1 - y0); db = abs(x1 - x0);
+		sa = (y0 < y1) ? 1 : -1; sb = (x0 < x1) ? 1 : -1;
+		amin = pOLED->iClipY0; amax = pOLED->iClipY1; bmin = pOLED->iClipX0; bmax = pOLED->iClipX1;
+	} else {
+		a0 = x0; b0 = y0; da = abs(x1 - x0); db = abs(y1 - y0);
+		sa = (x0 < x1) ? 1 : -1; sb = (y0 < y1) ? 1 : -1;
+		amin = pOLED->iClipX0; amax = pOLED->iClipX1; bmin = pOLED->iClipY0; bmax = pOLED->iClipY1;
+	}
+
+	// Steps whose major coordinate is inside the clip
+	lo = (sa > 0) ? (long long)amin - a0 : (long long)a0 - amax;
+	hi = (sa > 0) ? (long long)amax - a0 : (long long)a0 - amin;
+	if (lo < 0) lo = 0;
+	if (hi > da) hi = da;
+
+	// and whose minor coordinate is too; minor offset q(i) grows with i
+	q = (sb > 0) ? (long long)bmin - b0 : (long long)b0 - bmax;
+	if (q > 0) {	// first i with q(i) >= q
+		r = -oledFloorDiv(-(2LL * da * q - da + 1), 2LL * db);
+		if (r > lo) lo = r;
+	}
+	q = (sb > 0) ? (long long)bmax - b0 : (long long)b0 - bmin;
+	r = oledFloorDiv(2LL * da * (q + 1) - da, 2LL * db); // last i with q(i) <= q
+	if (r < hi) hi = r;
+	if (lo > hi)
+		return; // nothing visible
+
+	i0 = (int)lo;
+	i1 = (int)hi;
+	num = 2LL * i0 * db + da - 1;
+	q = num / (2LL * da);
+	r = num - q * 2LL * da;
+	a = a0 + sa * i0;
+	b = b0 + sb * (int)q;
+	for (i = i0; i <= i1; i++) {
+		int x = bSteep ? b : a;
+		int y = bSteep ? a : b;
+		unsigned char *d = &pOLED->ucScreen[(y >> 3)*pOLED->iPitch + x];
+		if (color)
+			*d |= (1 << (y & 7));
+		else
+			*d &= ~(1 << (y & 7));
+		oledMarkDirty(pOLED, y >> 3, x, x);
+		a += sa;
+		r += 2LL * db;
+		if (r >= 2LL * da) {
+			r -= 2LL * da;
+			b += sb;
+		}
+	}
+}
+
 // Draw a line.
-int oledLine(int x0, int y0, int x1, int y1, unsigned char color) {
+int oledLineCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, unsigned char color) {
 
-	int dx = abs(x1 - x0);
-    int dy = abs(y1 - y0);
-    int sx = (x0 < x1) ? 1 : -1;
-    int sy = (y0 < y1) ? 1 : -1;
-    int err = dx - dy;
-
-    while (1) {
-        oledSetPixel(x0, y0, color);
-        if (x0 == x1 && y0 == y1)
-            break;
-        int e2 = 2 * err;
-        if (e2 > -dy) {
-            err -= dy;
-            x0 += sx;
-        }
-        if (e2 < dx) {
-            err += dx;
-            y0 += sy;
-        }
-    }
+	if (!pOLED->bReady)
+		return -1;
+	oledDrawLine(pOLED, x0, y0, x1, y1, color);
+	oledUpdate(pOLED);
 
 	return 0;
 }
@@ -505,165 +2225,803 @@ void swap_int(int* a, int* b) {
     *b = temp;
 }
 
+// -----------------------------------------------------------
+// Helper: Integer edge stepper
+// Follows x = xa + (y - ya) * (xb - xa) / (yb - ya) down an edge as an
+// integer part plus a remainder 0 <= err < dy, so moving to the next
+// scanline is an add and a compare instead of a divide
+// -----------------------------------------------------------
+typedef struct {
+    int x, err;     // x on the current scanline is x + err/dy
+    int step, rem;  // x moves by step + rem/dy per scanline
+    int dy;
+} OLEDEDGE;
+
+// Set up an edge from (xa,ya) to (xb,yb), ya < yb, positioned at scanline y
+static void oledEdgeInit(OLEDEDGE *e, int xa, int ya, int xb, int yb, int y) {
+    long long num = (long long)(y - ya) * (xb - xa);
+    long long q;
+
+    e->dy = yb - ya;
+    e->step = (int)oledFloorDiv(xb - xa, e->dy);
+    e->rem = (xb - xa) - e->step * e->dy;
+    q = oledFloorDiv(num, e->dy);
+    e->x = xa + (int)q;
+    e->err = (int)(num - q * e->dy);
+}
+
+static void oledEdgeStep(OLEDEDGE *e) {
+    e->x += e->step;
+    e->err += e->rem;
+    if (e->err >= e->dy) {
+        e->x++;
+        e->err -= e->dy;
+    }
+}
+
+// First pixel center at or to the right of the edge
+static int oledEdgeCeil(OLEDEDGE *e) {
+    return e->x + (e->err != 0);
+}
+
+// Fill scanlines ya to yb-1 between a left and a right edge
+// Spans run from the left edge up to, but not including, the right edge
+static void oledEdgeRows(oled_t *pOLED, OLEDEDGE *l, OLEDEDGE *r, int ya, int yb, unsigned char color) {
+    for (int y = ya; y < yb; y++) {
+        int xl = oledEdgeCeil(l);
+        int xr = oledEdgeCeil(r) - 1;
+        if (xl <= xr)
+            oledHSpan(pOLED, xl, xr, y, color);
+        oledEdgeStep(l);
+        oledEdgeStep(r);
+    }
+}
+
 // Draw a triangle.
-int oledTriangle(int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color) {
+int oledTriangleCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color) {
+
+	if (!pOLED->bReady)
+		return -1;
+	oledDrawLine(pOLED, x0, y0, x1, y1, color);
+    oledDrawLine(pOLED, x1, y1, x2, y2, color);
+    oledDrawLine(pOLED, x2, y2, x0, y0, color);
+	oledUpdate(pOLED);
 
-	oledLine(x0, y0, x1, y1, color);
-    oledLine(x1, y1, x2, y2, color);
-    oledLine(x2, y2, x0, y0, color);
-	
 	return 0;
 }
 
-int oledFilledTriangle(int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color) {
+// Fill the pixels whose centers lie inside the triangle
+// Edges are walked with integer steppers and each scanline is one span.
+// Top-left rule: pixels exactly on a left or top edge are drawn, those on a
+// right or bottom edge are not, so triangles sharing an edge never overlap
+// or leave a gap between them.
+int oledFilledTriangleCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color) {
+
+	if (!pOLED->bReady)
+		return -1;
 
 	// Sort vertices by y-coordinate ascending (y0 <= y1 <= y2)
     if (y0 > y1) { swap_int(&y0, &y1); swap_int(&x0, &x1); }
     if (y1 > y2) { swap_int(&y1, &y2); swap_int(&x1, &x2); }
     if (y0 > y1) { swap_int(&y0, &y1); swap_int(&x0, &x1); }
 
-    int total_height = y2 - y0;
-
-    for (int i = 0; i <= total_height; i++) {
-        int second_half = i > (y1 - y0) || y1 == y0;
-        int segment_height = second_half ? y2 - y1 : y1 - y0;
-        float alpha = (float)i / total_height;
-        float beta = (float)(i - (second_half ? y1 - y0 : 0)) / segment_height;
-
-        int ax = x0 + (x2 - x0) * alpha;
-        int ay = y0 + i;
-        int bx = second_half ? x1 + (x2 - x1) * beta : x0 + (x1 - x0) * beta;
-
-        if (ax > bx) swap_int(&ax, &bx);
-
-        for (int x = ax; x <= bx; x++)
-            oledSetPixel(x, ay, color);
+    // Which side of the long edge (v0 to v2) the middle vertex is on
+    long long cross = (long long)(x1 - x0) * (y2 - y0) - (long long)(y1 - y0) * (x2 - x0);
+    if (cross == 0)
+        return 0; // no area
+
+    // Only walk the scanlines inside the clip rectangle
+    int xmin = (x0 < x1) ? x0 : x1, xmax = (x0 > x1) ? x0 : x1;
+    if (x2 < xmin) xmin = x2;
+    if (x2 > xmax) xmax = x2;
+    if (oledClipReject(pOLED, xmin, y0, xmax, y2))
+        return 0;
+    int ys = (y0 > pOLED->iClipY0) ? y0 : pOLED->iClipY0;
+    int ye = (y2 < pOLED->iClipY1 + 1) ? y2 : pOLED->iClipY1 + 1;
+
+    OLEDEDGE eLong, eShort;
+    oledEdgeInit(&eLong, x0, y0, x2, y2, ys);
+    if (y1 > ys) {	// upper half
+        int yb = (y1 < ye) ? y1 : ye;
+        oledEdgeInit(&eShort, x0, y0, x1, y1, ys);
+        if (cross < 0)
+            oledEdgeRows(pOLED, &eShort, &eLong, ys, yb, color);
+        else
+            oledEdgeRows(pOLED, &eLong, &eShort, ys, yb, color);
+    }
+    if (y2 > y1 && ye > y1 && ye > ys) {	// lower half
+        int ya = (y1 > ys) ? y1 : ys;
+        oledEdgeInit(&eShort, x1, y1, x2, y2, ya);
+        if (cross < 0)
+            oledEdgeRows(pOLED, &eShort, &eLong, ya, ye, color);
+        else
+            oledEdgeRows(pOLED, &eLong, &eShort, ya, ye, color);
     }
+	oledUpdate(pOLED);
 
 	return 0;
 }
 
 // Draw a polygon.
-int oledPolygon(int *vx, int *vy, int vertices, unsigned char color) {
+int oledPolygonCtx(oled_t *pOLED, int *vx, int *vy, int vertices, unsigned char color) {
 
+	if (!pOLED->bReady)
+		return -1;
 	for (int i = 0; i < vertices; i++) {
         int next = (i + 1) % vertices; // wrap last point to first
-        oledLine(vx[i], vy[i], vx[next], vy[next], color);
+        oledDrawLine(pOLED, vx[i], vy[i], vx[next], vy[next], color);
     }
-	
+	oledUpdate(pOLED);
+
 	return 0;
 }
-int oledFilledPolygon(int *vx, int *vy, int vertices, unsigned char color) {
+// Polygon edge for the scanline fill
+typedef struct {
+    int ytop, ybot; // scanlines ytop to ybot-1 cross this edge
+    int xa, ya, xb, yb;
+    int wind; // +1 going down, -1 going up
+    OLEDEDGE e;
+} OLEDPOLYEDGE;
+
+static int oledCompareEdges(const void *a, const void *b) {
+    return ((const OLEDPOLYEDGE *)a)->ytop - ((const OLEDPOLYEDGE *)b)->ytop;
+}
 
-	// Find min and max Y
-    int minY = vy[0], maxY = vy[0];
-    for (int i = 1; i < vertices; i++) {
-        if (vy[i] < minY) minY = vy[i];
-        if (vy[i] > maxY) maxY = vy[i];
-    }
+// Choose how oledFilledPolygon() treats self-intersecting outlines
+// OLED_FILL_EVENODD (default) or OLED_FILL_NONZERO
+int oledSetFillRuleCtx(oled_t *pOLED, int iRule) {
+    if (iRule != OLED_FILL_EVENODD && iRule != OLED_FILL_NONZERO)
+        return -1;
+    pOLED->iFillRule = iRule;
+    return 0;
+}
 
-    // Scan-line from minY to maxY
-    for (int y = minY; y <= maxY; y++) {
-        int nodes = 0;
-        int nodeX[_width]; // store intersections
+// Scanline fill with an edge table and an active edge list
+// Edges are sorted by their top scanline once, become active when the scan
+// reaches them and are stepped incrementally, so the cost is proportional
+// to edges + spans rather than edges x rows. Spans follow the same top-left
+// rule as oledFilledTriangle().
+int oledFilledPolygonCtx(oled_t *pOLED, int *vx, int *vy, int vertices, unsigned char color) {
 
-        // Find intersections with polygon edges
-        for (int i = 0; i < vertices; i++) {
-            int j = (i + 1) % vertices;
-            int yi = vy[i], yj = vy[j];
-            int xi = vx[i], xj = vx[j];
+	if (!pOLED->bReady)
+		return -1;
+	if (vertices < 3)
+		return 0;
+
+    OLEDPOLYEDGE *edges = malloc(vertices * sizeof(OLEDPOLYEDGE));
+    OLEDPOLYEDGE **active = malloc(vertices * sizeof(OLEDPOLYEDGE *));
+    if (edges == NULL || active == NULL) {
+        free(edges);
+        free(active);
+        return -1;
+    }
 
-            if ((yi < y && yj >= y) || (yj < y && yi >= y)) {
-                int x = xi + (y - yi) * (xj - xi) / (yj - yi);
-                nodeX[nodes++] = x;
+    // Build the edge table, horizontal edges never cross a scanline
+    int nEdges = 0;
+    for (int i = 0; i < vertices; i++) {
+        int j = (i + 1) % vertices; // wrap last point to first
+        if (vy[i] == vy[j])
+            continue;
+        OLEDPOLYEDGE *p = &edges[nEdges++];
+        if (vy[i] < vy[j]) {
+            p->xa = vx[i]; p->ya = vy[i]; p->xb = vx[j]; p->yb = vy[j];
+            p->wind = 1;
+        } else {
+            p->xa = vx[j]; p->ya = vy[j]; p->xb = vx[i]; p->yb = vy[i];
+            p->wind = -1;
+        }
+        p->ytop = p->ya;
+        p->ybot = p->yb;
+    }
+    qsort(edges, nEdges, sizeof(OLEDPOLYEDGE), oledCompareEdges);
+
+    int maxY = -1;
+    for (int i = 0; i < nEdges; i++)
+        if (edges[i].ybot > maxY) maxY = edges[i].ybot;
+    if (maxY > pOLED->iClipY1 + 1)
+        maxY = pOLED->iClipY1 + 1; // nothing below the clip rectangle is visible
+
+    // Edges that start above the clip rectangle are picked up at its top
+    int next = 0, nActive = 0;
+    int y = (nEdges > 0 && edges[0].ytop > pOLED->iClipY0) ? edges[0].ytop : pOLED->iClipY0;
+    for (; y < maxY; y++) {
+        // Activate edges that reach this scanline, drop finished ones
+        while (next < nEdges && edges[next].ytop <= y) {
+            OLEDPOLYEDGE *p = &edges[next++];
+            if (p->ybot > y) {
+                oledEdgeInit(&p->e, p->xa, p->ya, p->xb, p->yb, y);
+                active[nActive++] = p;
             }
         }
+        int k = 0;
+        for (int i = 0; i < nActive; i++)
+            if (active[i]->ybot > y) active[k++] = active[i];
+        nActive = k;
+        if (nActive == 0) {
+            if (next == nEdges)
+                break;
+            continue;
+        }
 
-        // Sort the nodes
-        for (int i = 0; i < nodes-1; i++) {
-            for (int j = i+1; j < nodes; j++) {
-                if (nodeX[i] > nodeX[j]) swap_int(&nodeX[i], &nodeX[j]);
+        // Keep the active list in x order; it changes little between
+        // scanlines, so insertion sort is close to linear
+        for (int i = 1; i < nActive; i++) {
+            OLEDPOLYEDGE *p = active[i];
+            int x = oledEdgeCeil(&p->e);
+            int j = i - 1;
+            while (j >= 0 && oledEdgeCeil(&active[j]->e) > x) {
+                active[j+1] = active[j];
+                j--;
             }
+            active[j+1] = p;
         }
 
-        // Fill pixels between node pairs
-        for (int i = 0; i < nodes; i += 2) {
-            if (i+1 >= nodes) break;
-            for (int x = nodeX[i]; x <= nodeX[i+1]; x++)
-                oledSetPixel(x, y, color);
+        // Emit the spans where the fill rule says we are inside
+        int wind = 0;
+        for (int i = 0; i < nActive; i++) {
+            int inside = (pOLED->iFillRule == OLED_FILL_NONZERO) ? (wind != 0) : (i & 1);
+            wind += active[i]->wind;
+            if (inside) {
+                int xl = oledEdgeCeil(&active[i-1]->e);
+                int xr = oledEdgeCeil(&active[i]->e) - 1;
+                if (xl <= xr)
+                    oledHSpan(pOLED, xl, xr, y, color);
+            }
         }
+
+        for (int i = 0; i < nActive; i++)
+            oledEdgeStep(&active[i]->e);
     }
-	
+
+    free(edges);
+    free(active);
+	oledUpdate(pOLED);
+
 	return 0;
 }
 
-int oledArc(int xc, int yc, int r, float sa, float ea, unsigned char color) {
+// -----------------------------------------------------------
+// Helper: Angular wedge from sa to ea degrees
+// Angles grow from +x towards +y (clockwise on screen). The start, end
+// and bisector directions are converted to fixed point once, so testing
+// a point is a few integer cross and dot products.
+// -----------------------------------------------------------
+typedef struct {
+    int bFull;           // 360 degrees or more
+    int bWide;           // more than 180 degrees
+    int sx, sy, ex, ey;  // start and end directions * 16384
+    int mx, my;          // bisector direction * 16384
+    int iOctants;        // bit k set if the wedge reaches octant k
+} OLEDWEDGE;
+
+static void oledWedgeInit(OLEDWEDGE *w, float sa, float ea) {
+    float sweep = ea - sa;
+    float a0 = fmodf(sa, 360.0f);
+    if (a0 < 0.0f) a0 += 360.0f;
+
+    w->bFull = (sweep >= 360.0f);
+    w->bWide = (sweep > 180.0f);
+    w->sx = (int)lroundf(cosf(sa * M_PI / 180.0f) * 16384.0f);
+    w->sy = (int)lroundf(sinf(sa * M_PI / 180.0f) * 16384.0f);
+    w->ex = (int)lroundf(cosf(ea * M_PI / 180.0f) * 16384.0f);
+    w->ey = (int)lroundf(sinf(ea * M_PI / 180.0f) * 16384.0f);
+    w->mx = (int)lroundf(cosf((sa + sweep/2) * M_PI / 180.0f) * 16384.0f);
+    w->my = (int)lroundf(sinf((sa + sweep/2) * M_PI / 180.0f) * 16384.0f);
+    w->iOctants = 0;
+    for (int k = 0; k < 16; k++) { // octant k and its copy one turn later
+        if (w->bFull || (45.0f*k <= a0 + sweep && 45.0f*(k+1) >= a0))
+            w->iOctants |= 1 << (k & 7);
+    }
+}
+
+// Is the point (dx,dy) from the center inside the wedge (edges included)
+static int oledWedgeContains(OLEDWEDGE *w, int dx, int dy) {
+    long long cs, ce, dot;
+
+    if (w->bFull)
+        return 1;
+    cs = (long long)w->sx * dy - (long long)w->sy * dx; // >= 0 past the start
+    ce = (long long)w->ex * dy - (long long)w->ey * dx; // <= 0 before the end
+    dot = (long long)w->mx * dx + (long long)w->my * dy;
+    if (w->bWide) // everything except the (open) wedge from end to start
+        return !(ce > 0 && cs < 0 && dot < 0);
+    return (cs >= 0 && ce <= 0 && dot >= 0);
+}
+
+// Narrow [*lo,*hi] to the x where a*x + b*dy >= c
+static void oledHalfPlane(long long a, long long b, long long c, int dy, int *lo, int *hi) {
+    long long t = c - b * dy;
+
+    if (a > 0) {
+        long long v = -oledFloorDiv(-t, a); // ceil(t / a)
+        if (v > *lo) *lo = (int)v;
+    } else if (a < 0) {
+        long long v = oledFloorDiv(-t, -a); // floor(t / a)
+        if (v < *hi) *hi = (int)v;
+    } else if (t > 0) {
+        *lo = 1; *hi = 0; // no x satisfies it
+    }
+}
+
+// Draw the part of a circle from angle sa to ea (degrees)
+// Uses the same integer midpoint walk as oledCircle(), visits only the
+// octants the arc reaches and plots every pixel exactly once. An end
+// angle before the start angle draws nothing; 360 degrees or more draws
+// the whole circle.
+int oledArcCtx(oled_t *pOLED, int xc, int yc, int r, float sa, float ea, unsigned char color) {
 
-	// Convert degrees to radians
-    float start_rad = sa * M_PI / 180.0f;
-    float end_rad = ea * M_PI / 180.0f;
+	// octant k maps the walk point (x,y), 0 <= x <= y, to (dx,dy)
+	static const signed char ox[8][4] = {
+		{0,1,1,0}, {1,0,0,1}, {-1,0,0,1}, {0,-1,1,0},
+		{0,-1,-1,0}, {-1,0,0,-1}, {1,0,0,-1}, {0,1,-1,0}};
+	OLEDWEDGE w;
+
+	if (!pOLED->bReady)
+		return -1;
+	if (r < 0 || ea < sa || oledClipReject(pOLED, xc - r, yc - r, xc + r, yc + r))
+		return 0;
+
+	oledWedgeInit(&w, sa, ea);
+	if (r == 0) {
+		oledPlot(pOLED, xc, yc, color);
+		oledUpdate(pOLED);
+		return 0;
+	}
 
-    float step = 0.01f; // smaller = smoother arc
+	int x = 0;
+    int y = r;
+    int d = 3 - 2 * r;
 
-    for (float theta = start_rad; theta <= end_rad; theta += step)
+    while (y >= x)
     {
-        int x = xc + (int)(r * cosf(theta));
-        int y = yc + (int)(r * sinf(theta));
-        oledSetPixel(x, y, color);
+        for (int k = 0; k < 8; k++) {
+            if (!(w.iOctants & (1 << k)))
+                continue;
+            // each octant owns the boundary at its start angle
+            if ((k & 1) ? (x == 0) : (x == y))
+                continue;
+            int dx = ox[k][0] * x + ox[k][1] * y;
+            int dy = ox[k][2] * x + ox[k][3] * y;
+            if (oledWedgeContains(&w, dx, dy))
+                oledPlot(pOLED, xc + dx, yc + dy, color);
+        }
+
+        x++;
+
+        if (d > 0) {
+            y--;
+            d = d + 4 * (x - y) + 10;
+        } else {
+            d = d + 4 * x + 6;
+        }
     }
-	
+	oledUpdate(pOLED);
+
 	return 0;
 }
 
-int oledBezier(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, unsigned char color) {
+// Draw a filled pie slice (sector) from angle sa to ea (degrees)
+// Covers the pixels of oledFilledCircle() inside the wedge. Each row of
+// the disk is one span clipped against the wedge's half-planes, which
+// leaves at most two spans per row.
+int oledFilledArcCtx(oled_t *pOLED, int xc, int yc, int r, float sa, float ea, unsigned char color) {
 
-	int prev_x = x0;
-    int prev_y = y0;
-    float step = 0.01f; // smaller = smoother curve
+	OLEDWEDGE w;
 
-    for (float t = step; t <= 1.0f; t += step)
-    {
-        float u = 1 - t;
-        float tt = t * t;
-        float uu = u * u;
-        float uuu = uu * u;
-        float ttt = tt * t;
-
-        float xf = uuu * x0
-                 + 3 * uu * t * x1
-                 + 3 * u * tt * x2
-                 + ttt * x3;
-
-        float yf = uuu * y0
-                 + 3 * uu * t * y1
-                 + 3 * u * tt * y2
-                 + ttt * y3;
-
-        int xi = (int)(xf + 0.5f);
-        int yi = (int)(yf + 0.5f);
-
-        oledLine(prev_x, prev_y, xi, yi, color);
-        prev_x = xi;
-        prev_y = yi;
+	if (!pOLED->bReady)
+		return -1;
+	if (r < 0 || ea < sa || oledClipReject(pOLED, xc - r, yc - r, xc + r, yc + r))
+		return 0;
+
+	oledWedgeInit(&w, sa, ea);
+	long long r2 = (long long)r * r;
+	int h = r;
+
+	for (int dy = 0; dy <= r; dy++) {
+        while (h > 0 && (long long)h * h + (long long)dy * dy > r2)
+            h--;
+        for (int side = 0; side < 2; side++) {
+            int row = side ? -dy : dy;
+            if (side && dy == 0)
+                break;
+            if (w.bFull) {
+                oledHSpan(pOLED, xc - h, xc + h, yc + row, color);
+                continue;
+            }
+            // Interval of x inside (narrow) or excluded from (wide) the wedge
+            int lo = -h, hi = h;
+            if (!w.bWide) {
+                oledHalfPlane(-w.sy, w.sx, 0, row, &lo, &hi);
+                oledHalfPlane(w.ey, -w.ex, 0, row, &lo, &hi);
+                oledHalfPlane(w.mx, w.my, 0, row, &lo, &hi);
+                if (lo <= hi)
+                    oledHSpan(pOLED, xc + lo, xc + hi, yc + row, color);
+            } else {
+                oledHalfPlane(w.sy, -w.sx, 1, row, &lo, &hi);
+                oledHalfPlane(-w.ey, w.ex, 1, row, &lo, &hi);
+                oledHalfPlane(-w.mx, -w.my, 1, row, &lo, &hi);
+                if (lo > hi) {
+                    oledHSpan(pOLED, xc - h, xc + h, yc + row, color);
+                } else {
+                    if (lo > -h)
+                        oledHSpan(pOLED, xc - h, xc + lo - 1, yc + row, color);
+                    if (hi < h)
+                        oledHSpan(pOLED, xc + hi + 1, xc + h, yc + row, color);
+                }
+            }
+        }
     }
+	oledUpdate(pOLED);
 
 	return 0;
 }
 
-int oledParabola(int h, int k, float a, int xs, int xe, unsigned char color) {
+// Largest n with n*n <= v
+static int oledISqrt(long long v) {
+    long long r = (long long)sqrt((double)v);
+
+    while (r * r > v)
+        r--;
+    while ((r + 1) * (r + 1) <= v)
+        r++;
+    return (int)r;
+}
 
-	int prev_x = xs;
-    int prev_y = k + (int)(a * (xs - h) * (xs - h) + 0.5f);
+// Number of chords for a curve whose second difference is dd (L1 norm)
+// and whose control polygon is iLen pixels long. A chord over a span
+// with |B''| <= M strays at most M/(8n^2) from the curve; keep that
+// under half a pixel, but never make chords shorter than a pixel.
+static int oledCurveSteps(long long dd, int iLen) {
+    int n = oledISqrt(dd);
+
+    if ((long long)n * n < dd)
+        n++;
+    if (n > iLen)
+        n = iLen;
+    if (n > 1024)
+        n = 1024;
+    return (n < 1) ? 1 : n;
+}
 
-    for (int x = xs + 1; x <= xe; x++)
-    {
-        int y = k + (int)(a * (x - h) * (x - h) + 0.5f);
-        // oledSetPixel(x, y, color);
-        // Optional: draw line for smoother curve
-        oledLine(prev_x, prev_y, x, y, color);
+// Walk a polynomial segment a*t^3 + b*t^2 + c*t + d for t = 0..1 in n
+// steps by forward differencing, in 32.32 fixed point, and connect the
+// points with lines. The last point is snapped to the exact endpoint.
+static void oledDrawCurve(oled_t *pOLED, const long long *cx, const long long *cy, int n, int xe, int ye, unsigned char color) {
+    long long n2 = (long long)n * n, n3 = n2 * n;
+    long long x, dx1, dx2, dx3, y, dy1, dy2, dy3, a3, b2, c1;
+    int px, py, ix, iy;
+
+    a3 = oledFloorDiv(cx[0] * (1LL << 33) + n3, 2 * n3);
+    b2 = oledFloorDiv(cx[1] * (1LL << 33) + n2, 2 * n2);
+    c1 = oledFloorDiv(cx[2] * (1LL << 33) + n, 2LL * n);
+    x = cx[3] * (1LL << 32) + (1LL << 31); // pre-biased for rounding
+    dx1 = a3 + b2 + c1; dx2 = 6 * a3 + 2 * b2; dx3 = 6 * a3;
+    a3 = oledFloorDiv(cy[0] * (1LL << 33) + n3, 2 * n3);
+    b2 = oledFloorDiv(cy[1] * (1LL << 33) + n2, 2 * n2);
+    c1 = oledFloorDiv(cy[2] * (1LL << 33) + n, 2LL * n);
+    y = cy[3] * (1LL << 32) + (1LL << 31);
+    dy1 = a3 + b2 + c1; dy2 = 6 * a3 + 2 * b2; dy3 = 6 * a3;
+
+    px = (int)cx[3];
+    py = (int)cy[3];
+    for (int i = 1; i <= n; i++) {
+        x += dx1; dx1 += dx2; dx2 += dx3;
+        y += dy1; dy1 += dy2; dy2 += dy3;
+        if (i == n) {
+            ix = xe;
+            iy = ye;
+        } else {
+            ix = (int)oledFloorDiv(x, 1LL << 32);
+            iy = (int)oledFloorDiv(y, 1LL << 32);
+        }
+        if (ix != px || iy != py || i == 1)
+            oledDrawLine(pOLED, px, py, ix, iy, color);
+        px = ix;
+        py = iy;
+    }
+}
+
+int oledBezierCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, unsigned char color) {
+    long long cx[4], cy[4], dd, d2;
+    int iLen;
+
+	if (!pOLED->bReady)
+		return -1;
+
+    // power basis coefficients
+    cx[0] = -x0 + 3LL * x1 - 3LL * x2 + x3;
+    cx[1] = 3LL * x0 - 6LL * x1 + 3LL * x2;
+    cx[2] = 3LL * (x1 - x0);
+    cx[3] = x0;
+    cy[0] = -y0 + 3LL * y1 - 3LL * y2 + y3;
+    cy[1] = 3LL * y0 - 6LL * y1 + 3LL * y2;
+    cy[2] = 3LL * (y1 - y0);
+    cy[3] = y0;
+
+    // |B''| <= 6 * max second difference of the control points
+    dd = llabs((long long)x0 - 2LL * x1 + x2) + llabs((long long)y0 - 2LL * y1 + y2);
+    d2 = llabs((long long)x1 - 2LL * x2 + x3) + llabs((long long)y1 - 2LL * y2 + y3);
+    if (d2 > dd)
+        dd = d2;
+    iLen = abs(x1 - x0) + abs(y1 - y0) + abs(x2 - x1) + abs(y2 - y1) + abs(x3 - x2) + abs(y3 - y2);
+
+    oledDrawCurve(pOLED, cx, cy, oledCurveSteps((3 * dd + 1) / 2, iLen), x3, y3, color);
+	oledUpdate(pOLED);
+
+	return 0;
+}
+
+int oledQuadBezierCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color) {
+    long long cx[4], cy[4], dd;
+    int iLen;
+
+	if (!pOLED->bReady)
+		return -1;
+
+    cx[0] = 0;
+    cx[1] = (long long)x0 - 2LL * x1 + x2;
+    cx[2] = 2LL * (x1 - x0);
+    cx[3] = x0;
+    cy[0] = 0;
+    cy[1] = (long long)y0 - 2LL * y1 + y2;
+    cy[2] = 2LL * (y1 - y0);
+    cy[3] = y0;
+
+    // |B''| = 2 * second difference of the control points
+    dd = llabs(cx[1]) + llabs(cy[1]);
+    iLen = abs(x1 - x0) + abs(y1 - y0) + abs(x2 - x1) + abs(y2 - y1);
+
+    oledDrawCurve(pOLED, cx, cy, oledCurveSteps((dd + 1) / 2, iLen), x2, y2, color);
+	oledUpdate(pOLED);
+
+	return 0;
+}
+
+int oledParabolaCtx(oled_t *pOLED, int h, int k, float a, int xs, int xe, unsigned char color) {
+    long long y, d, d2;
+    double m;
+    int s, prev_x, prev_y, iy;
+
+	if (!pOLED->bReady)
+		return -1;
+
+    // columns beyond -1 and the width only feed chords that are off screen
+    if (xs < -1)
+        xs = -1;
+    if (xe > oledColumnCount(pOLED))
+        xe = oledColumnCount(pOLED);
+    if (xs > xe)
+        return 0;
+
+    // y = k + a*(x-h)^2 stepped by its first and second differences.
+    // Use 32 fraction bits unless the values would not fit.
+    m = fmax(fabs((double)xs - h), fabs((double)xe - h)) + 1.0;
+    m = fabs((double)a) * m * m;
+    for (s = 32; s > 0 && m * (double)(1LL << s) >= (double)(1LL << 61); s--)
+        ;
+    y = llround((double)a * ((double)xs - h) * ((double)xs - h) * (double)(1LL << s));
+    d = llround((double)a * (2.0 * ((double)xs - h) + 1.0) * (double)(1LL << s));
+    d2 = llround(2.0 * (double)a * (double)(1LL << s));
+    y += (1LL << s) >> 1; // pre-biased for rounding
+
+    prev_x = xs;
+    prev_y = k + (int)oledFloorDiv(y, 1LL << s);
+    for (int x = xs + 1; x <= xe; x++) {
+        y += d;
+        d += d2;
+        iy = k + (int)oledFloorDiv(y, 1LL << s);
+        oledDrawLine(pOLED, prev_x, prev_y, x, iy, color);
         prev_x = x;
-        prev_y = y;
+        prev_y = iy;
     }
-	
+	oledUpdate(pOLED);
+
 	return 0;
 }
+
+// -----------------------------------------------------------
+// Default display
+// The functions without a context argument draw on oledDefault
+// -----------------------------------------------------------
+
+int oledInit(int iChannel, int iAddr, int iType, int bFlip, int bInvert) {
+	return oledInitCtx(&oledDefault, iChannel, iAddr, iType, bFlip, bInvert);
+}
+
+int oledSetAddressingMode(int iMode) {
+	return oledSetAddressingModeCtx(&oledDefault, iMode);
+}
+
+void oledShutdown(void) {
+	oledShutdownCtx(&oledDefault);
+}
+
+void oledSetTransport(OLEDTRANSPORT pfnXfer, void *pUser) {
+	oledSetTransportCtx(&oledDefault, pfnXfer, pUser);
+}
+
+unsigned long oledSkippedCommands(void) {
+	return oledSkippedCommandsCtx(&oledDefault);
+}
+
+int oledSetContrast(unsigned char ucContrast) {
+	return oledSetContrastCtx(&oledDefault, ucContrast);
+}
+
+int oledScrollStart(int iDir, int iStartPage, int iEndPage, int iFrames, int iVertical) {
+	return oledScrollStartCtx(&oledDefault, iDir, iStartPage, iEndPage, iFrames, iVertical);
+}
+
+int oledScrollStop(void) {
+	return oledScrollStopCtx(&oledDefault);
+}
+
+int oledSetScrollArea(int iTopRows, int iRows) {
+	return oledSetScrollAreaCtx(&oledDefault, iTopRows, iRows);
+}
+
+int oledScrollPages(int iStartPage, int iEndPage, int iDx) {
+	return oledScrollPagesCtx(&oledDefault, iStartPage, iEndPage, iDx);
+}
+
+int oledSetClip(int x, int y, int w, int h) {
+	return oledSetClipCtx(&oledDefault, x, y, w, h);
+}
+
+int oledResetClip(void) {
+	return oledResetClipCtx(&oledDefault);
+}
+
+int oledSetPixel(int x, int y, unsigned char ucColor) {
+	return oledSetPixelCtx(&oledDefault, x, y, ucColor);
+}
+
+int oledSetDeferred(int bDeferred) {
+	return oledSetDeferredCtx(&oledDefault, bDeferred);
+}
+
+int oledFlush(void) {
+	return oledFlushCtx(&oledDefault);
+}
+
+int oledSetAsync(int bAsync) {
+	return oledSetAsyncCtx(&oledDefault, bAsync);
+}
+
+int oledPresent(void) {
+	return oledPresentCtx(&oledDefault);
+}
+
+int oledWriteString(int x, int y, char *szMsg, int iSize) {
+	return oledWriteStringCtx(&oledDefault, x, y, szMsg, iSize);
+}
+
+int oledFill(unsigned char ucData) {
+	return oledFillCtx(&oledDefault, ucData);
+}
+
+int oledPrintf(int x, int y, char *szMsg, int iSize, ...) {
+	va_list args;
+
+	va_start(args, iSize);
+	int r = oledVPrintf(&oledDefault, x, y, szMsg, iSize, args);
+	va_end(args);
+
+	return r;
+}
+
+int oledConsoleClear(int iSize) {
+	return oledConsoleClearCtx(&oledDefault, iSize);
+}
+
+int oledConsolePuts(char *szMsg) {
+	return oledConsolePutsCtx(&oledDefault, szMsg);
+}
+
+int oledDrawString(int x, int y, char *szMsg, int iSize, int iMode) {
+	return oledDrawStringCtx(&oledDefault, x, y, szMsg, iSize, iMode);
+}
+
+int oledBlit(int x, int y, unsigned char *pBitmap, int w, int h, int iRop) {
+	return oledBlitCtx(&oledDefault, x, y, pBitmap, w, h, iRop);
+}
+
+int oledBlitRows(int x, int y, unsigned char *pBitmap, int w, int h, int iRop) {
+	return oledBlitRowsCtx(&oledDefault, x, y, pBitmap, w, h, iRop);
+}
+
+int oledSpriteSet(int iSprite, unsigned char *pBitmap, unsigned char *pMask, int w, int h) {
+	return oledSpriteSetCtx(&oledDefault, iSprite, pBitmap, pMask, w, h);
+}
+
+int oledSpriteMove(int iSprite, int x, int y) {
+	return oledSpriteMoveCtx(&oledDefault, iSprite, x, y);
+}
+
+int oledSpriteHide(int iSprite) {
+	return oledSpriteHideCtx(&oledDefault, iSprite);
+}
+
+int oledCircle(int xc, int yc, int r, unsigned char color) {
+	return oledCircleCtx(&oledDefault, xc, yc, r, color);
+}
+
+int oledHLine(int x, int y, int length, unsigned char color) {
+	return oledHLineCtx(&oledDefault, x, y, length, color);
+}
+
+int oledVLine(int x, int y, int length, unsigned char color) {
+	return oledVLineCtx(&oledDefault, x, y, length, color);
+}
+
+int oledFilledCircle(int xc, int yc, int r, unsigned char color) {
+	return oledFilledCircleCtx(&oledDefault, xc, yc, r, color);
+}
+
+int oledSquare(int x, int y, int size, unsigned char color) {
+	return oledSquareCtx(&oledDefault, x, y, size, color);
+}
+
+int oledFilledSquare(int x, int y, int size, unsigned char color) {
+	return oledFilledSquareCtx(&oledDefault, x, y, size, color);
+}
+
+int oledRectangle(int x, int y, int width, int height, unsigned char color) {
+	return oledRectangleCtx(&oledDefault, x, y, width, height, color);
+}
+
+int oledFilledRectangle(int x, int y, int width, int height, unsigned char color) {
+	return oledFilledRectangleCtx(&oledDefault, x, y, width, height, color);
+}
+
+int oledEllipse(int xc, int yc, int rx, int ry, unsigned char color) {
+	return oledEllipseCtx(&oledDefault, xc, yc, rx, ry, color);
+}
+
+int oledFilledEllipse(int xc, int yc, int rx, int ry, unsigned char color) {
+	return oledFilledEllipseCtx(&oledDefault, xc, yc, rx, ry, color);
+}
+
+int oledLine(int x0, int y0, int x1, int y1, unsigned char color) {
+	return oledLineCtx(&oledDefault, x0, y0, x1, y1, color);
+}
+
+int oledTriangle(int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color) {
+	return oledTriangleCtx(&oledDefault, x0, y0, x1, y1, x2, y2, color);
+}
+
+int oledFilledTriangle(int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color) {
+	return oledFilledTriangleCtx(&oledDefault, x0, y0, x1, y1, x2, y2, color);
+}
+
+int oledPolygon(int *vx, int *vy, int vertices, unsigned char color) {
+	return oledPolygonCtx(&oledDefault, vx, vy, vertices, color);
+}
+
+int oledSetFillRule(int iRule) {
+	return oledSetFillRuleCtx(&oledDefault, iRule);
+}
+
+int oledFilledPolygon(int *vx, int *vy, int vertices, unsigned char color) {
+	return oledFilledPolygonCtx(&oledDefault, vx, vy, vertices, color);
+}
+
+int oledArc(int xc, int yc, int r, float sa, float ea, unsigned char color) {
+	return oledArcCtx(&oledDefault, xc, yc, r, sa, ea, color);
+}
+
+int oledFilledArc(int xc, int yc, int r, float sa, float ea, unsigned char color) {
+	return oledFilledArcCtx(&oledDefault, xc, yc, r, sa, ea, color);
+}
+
+int oledBezier(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, unsigned char color) {
+	return oledBezierCtx(&oledDefault, x0, y0, x1, y1, x2, y2, x3, y3, color);
+}
+
+int oledQuadBezier(int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color) {
+	return oledQuadBezierCtx(&oledDefault, x0, y0, x1, y1, x2, y2, color);
+}
+
+int oledParabola(int h, int k, float a, int xs, int xe, unsigned char color) {
+	return oledParabolaCtx(&oledDefault, h, k, a, xs, xe, color);
+}
@@ -28,19 +28,102 @@ enum {
   OLED_64x32
 };
 
+// Memory addressing modes for oledSetAddressingMode()
+enum {
+  OLED_ADDR_PAGE = 0,
+  OLED_ADDR_HORIZONTAL,
+  OLED_ADDR_VERTICAL
+};
+
+// Fill rules for oledSetFillRule()
+enum {
+  OLED_FILL_EVENODD = 0,
+  OLED_FILL_NONZERO
+};
+
+// Text modes for oledDrawString()
+enum {
+  OLED_TEXT_TRANSPARENT = 0, // draw the set pixels of each glyph
+  OLED_TEXT_OPAQUE,          // replace the whole glyph cell
+  OLED_TEXT_XOR              // invert the pixels under the set ones
+};
+
+// Raster ops for oledBlit()
+enum {
+  OLED_ROP_COPY = 0, // replace the pixels under the bitmap
+  OLED_ROP_OR,       // set the pixels that are set in the bitmap
+  OLED_ROP_AND,      // clear the pixels that are clear in the bitmap
+  OLED_ROP_XOR,      // invert the pixels that are set in the bitmap
+  OLED_ROP_NOT       // copy the inverted bitmap
+};
+
+// Hardware scroll directions for oledScrollStart()
+enum {
+  OLED_SCROLL_RIGHT = 0,
+  OLED_SCROLL_LEFT,
+  OLED_SCROLL_DIAG_RIGHT, // right and up (vertical offset) each step
+  OLED_SCROLL_DIAG_LEFT   // left and up
+};
+
 typedef enum
 {
    FONT_NORMAL=0,	// 8x8
-   FONT_BIG,		// 16x24
+   FONT_BIG,		// 16x32
    FONT_SMALL		// 6x8
 } FONTSIZE;
 
+// One I2C message for the display: a control byte (0x00 = commands,
+// 0x40 = data) followed by the payload
+typedef struct
+{
+   unsigned char *pData;
+   int iLen;
+} OLEDMSG;
+
+// Transport function that delivers iCount messages as one transaction
+// Returns 0 for success
+typedef int (*OLEDTRANSPORT)(void *pUser, OLEDMSG *pMsgs, int iCount);
+
+// One display: its I2C handle, local frame buffer and drawing state
+// Every function below has a Ctx variant taking the display as its first
+// argument (e.g. oledLineCtx()), so one process can drive many panels.
+// The plain functions use a built-in default display.
+typedef struct oled_t oled_t;
+
+// Allocate a context for another display, then oledInitCtx() it
+// Returns NULL if out of memory
+oled_t *oledCreate(void);
+
+// Shut the display down (if initialized) and free its context
+void oledDestroy(oled_t *pOLED);
+
+// Create a video wall, one drawing canvas of iCols x iRows 128x64 panels
+// All the Ctx drawing functions work on it across panel boundaries; when
+// it is flushed each panel gets its part, buses in parallel.
+// Free it with oledDestroy(), which leaves the panels alone.
+oled_t *oledWallCreate(int iCols, int iRows);
+
+// Place an initialized 128x64 display at panel column iCol, row iRow
+// returns 0 for success, -1 for a bad position or display type
+int oledWallAttach(oled_t *pWall, int iCol, int iRow, oled_t *pPanel);
+
+// Replace the default I2C_RDWR transport, e.g. with a mock for testing
+// without hardware. Call before oledInit(); when a transport is set,
+// oledInit() does not open the I2C bus. Pass NULL to restore the default.
+void oledSetTransport(OLEDTRANSPORT pfnXfer, void *pUser);
+
 // Initialize the OLED96 library for a specific I2C address
 // Optionally enable inverted or flipped mode
 // returns 0 for success, 1 for failure
 //
 int oledInit(int iChannel, int iAddress, int iType, int bFlip, int bInvert);
 
+// Select page, horizontal or vertical memory addressing
+// May be called before oledInit() to pick the mode used at init
+// Horizontal/vertical let oledFlush() stream a dirty rectangle as one transfer
+// returns 0 for success, -1 for an unsupported mode
+int oledSetAddressingMode(int iMode);
+
 // Turns off the display and closes the I2C handle
 void oledShutdown(void);
 
@@ -48,18 +131,98 @@ void oledShutdown(void);
 int oledFill(unsigned char ucPattern);
 
 // Write a text string to the display at x (column 0-127) and y (row 0-7)
-// bLarge = 0 - 8x8 font, bLarge = 1 - 16x24 font
+// bLarge = 0 - 8x8 font, bLarge = 1 - 16x32 font, 2 - 6x8 font
 int oledWriteString(int x, int y, char *szText, int bLarge);
 int oledPrintf(int x, int y, char *szText, int bLarge, ...);
 
+// Draw text at any pixel position (x,y), the top left of the first glyph
+// Unlike oledWriteString() it draws into the frame buffer over what is
+// already there, using one of the OLED_TEXT_* modes
+int oledDrawString(int x, int y, char *szText, int iSize, int iMode);
+
+// Text console: oledConsoleClear() clears the screen and homes the cursor,
+// oledConsolePuts() writes at the cursor, handling '\n' and '\r',
+// wrapping at the right edge and scrolling up at the bottom
+// Scrolling moves the display start line, so only the new line is sent
+int oledConsoleClear(int iSize);
+int oledConsolePuts(char *szText);
+
+// Draw a w x h bitmap with its top left corner at pixel (x,y)
+// combined with the screen by one of the OLED_ROP_* raster ops
+// oledBlit() takes the display's page-major format (w bytes per 8 rows,
+// LSB on top), oledBlitRows() takes rows of (w+7)/8 bytes, MSB on the left
+int oledBlit(int x, int y, unsigned char *pBitmap, int w, int h, int iRop);
+int oledBlitRows(int x, int y, unsigned char *pBitmap, int w, int h, int iRop);
+
+// Sprites 0-7: masked bitmaps (up to 32x32, page-major) drawn over the
+// frame buffer, higher numbers on top. Moving or hiding one puts back
+// the pixels it covered and only sends its old and new boxes.
+// Sprites are not clipped by oledSetClip(). Draw under a visible sprite only after hiding it.
+int oledSpriteSet(int iSprite, unsigned char *pBitmap, unsigned char *pMask, int w, int h);
+int oledSpriteMove(int iSprite, int x, int y);
+int oledSpriteHide(int iSprite);
+
+// Select deferred (1) or immediate (0) drawing
+// In deferred mode drawing only updates the local copy of the display
+// and oledFlush() sends the changes; leaving deferred mode flushes
+int oledSetDeferred(int bDeferred);
+
+// Sends any pending changes from the local copy to the display
+// After a failed transfer the next flush sends the whole screen again
+int oledFlush(void);
+
+// Start (1) or stop (0) a background thread that sends frames to the display
+// While it runs drawing is deferred and oledPresent() hands each frame over,
+// so drawing the next frame overlaps sending the current one. Stopping it
+// returns to the mode it was started in, flushing if that was immediate
+int oledSetAsync(int bAsync);
+
+// Present the frame drawn so far; returns without waiting for the bus
+// unless the previous frame is still being sent
+int oledPresent(void);
+
+// Flush several displays at once: displays on different buses are sent in
+// parallel by one worker thread per bus, those sharing a bus one at a time
+// Returns 0 if all were flushed, -1 otherwise
+int oledFlushMany(oled_t **ppOLED, int iCount);
+
 // Sets a pixel to On (1) or Off (0)
 // Coordinate system is pixels, not text rows (0-127, 0-63)
 int oledSetPixel(int x, int y, unsigned char ucPixel);
 
+// Number of position command bytes the library did not send because the
+// display's write pointer was already at the right page or column
+unsigned long oledSkippedCommands(void);
+
 // Sets the contrast (brightness) level of the display
 // Valid values are 0-255 where 0=off and 255=max brightness
 int oledSetContrast(unsigned char ucContrast);
 
+// Start a continuous hardware scroll of pages iStartPage-iEndPage, one
+// column every iFrames frames (2-256), without using the bus
+// iVertical (0-63) is the upward step of the diagonal directions
+// The controller's memory can't be written while it scrolls, so drawing
+// and flushes only update the local copy until oledScrollStop(), which
+// rewrites the scrolled pages and sends what was held back (except an
+// unflushed frame in deferred mode)
+// Not available on OLED_132x64 displays
+int oledScrollStart(int iDir, int iStartPage, int iEndPage, int iFrames, int iVertical);
+int oledScrollStop(void);
+// Rows moved by a diagonal scroll: iRows after iTopRows fixed ones
+int oledSetScrollArea(int iTopRows, int iRows);
+
+// Scroll pages iStartPage-iEndPage of the frame buffer iDx pixels
+// right (left if negative), clearing the columns scrolled in
+int oledScrollPages(int iStartPage, int iEndPage, int iDx);
+
+// Limit all drawing to the w x h pixel rectangle at (x,y)
+// Shapes are clipped to it up front, so only their visible part costs time
+// Text is clipped too; oledFill() and oledScrollPages() always work on
+// whole pages and sprites ignore it
+int oledSetClip(int x, int y, int w, int h);
+// Clip to the whole screen again (the default)
+int oledResetClip(void);
+
 int oledCircle(int xc, int yc, int r, unsigned char color);
 int oledFilledCircle(int xc, int yc, int r, unsigned char color);
 int oledSquare(int x, int y, int size, unsigned char color);
@@ -69,11 +232,76 @@ int oledFilledRectangle(int x, int y, int width, int height, unsigned char color
 int oledEllipse(int xc, int yc, int rx, int ry, unsigned char color);
 int oledFilledEllipse(int xc, int yc, int rx, int ry, unsigned char color);
 int oledTriangle(int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color);
+// Filled triangles use the top-left fill rule: pixels on a shared edge belong
+// to exactly one triangle, so meshes have no gaps and no double-drawn pixels
 int oledFilledTriangle(int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color);
 int oledLine(int x0, int y0, int x1, int y1, unsigned char color);
+// Horizontal line of length pixels starting at (x,y) going right
+int oledHLine(int x, int y, int length, unsigned char color);
+// Vertical line of length pixels starting at (x,y) going down
+int oledVLine(int x, int y, int length, unsigned char color);
 int oledPolygon(int *vx, int *vy, int vertices, unsigned char color);
 int oledFilledPolygon(int *vx, int *vy, int vertices, unsigned char color);
+// Select the fill rule used by oledFilledPolygon() for self-intersecting
+// outlines: OLED_FILL_EVENODD (default) or OLED_FILL_NONZERO
+int oledSetFillRule(int iRule);
+// Arcs and pie slices run from angle sa to ea in degrees, clockwise on screen
 int oledArc(int xc, int yc, int r, float sa, float ea, unsigned char color);
+int oledFilledArc(int xc, int yc, int r, float sa, float ea, unsigned char color);
+// Bezier curves are drawn as chords, more of them the longer and more bent
+// the curve is, staying within half a pixel of the true curve
 int oledBezier(int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, unsigned char color);
+int oledQuadBezier(int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color);
 int oledParabola(int h, int k, float a, int xs, int xe, unsigned char color);
+
+// Context variants of the functions above
+void oledSetTransportCtx(oled_t *pOLED, OLEDTRANSPORT pfnXfer, void *pUser);
+int oledInitCtx(oled_t *pOLED, int iChannel, int iAddr, int iType, int bFlip, int bInvert);
+int oledSetAddressingModeCtx(oled_t *pOLED, int iMode);
+void oledShutdownCtx(oled_t *pOLED);
+int oledFillCtx(oled_t *pOLED, unsigned char ucData);
+int oledWriteStringCtx(oled_t *pOLED, int x, int y, char *szMsg, int iSize);
+int oledPrintfCtx(oled_t *pOLED, int x, int y, char *szMsg, int iSize, ...);
+int oledDrawStringCtx(oled_t *pOLED, int x, int y, char *szMsg, int iSize, int iMode);
+int oledConsoleClearCtx(oled_t *pOLED, int iSize);
+int oledConsolePutsCtx(oled_t *pOLED, char *szMsg);
+int oledBlitCtx(oled_t *pOLED, int x, int y, unsigned char *pBitmap, int w, int h, int iRop);
+int oledBlitRowsCtx(oled_t *pOLED, int x, int y, unsigned char *pBitmap, int w, int h, int iRop);
+int oledSpriteSetCtx(oled_t *pOLED, int iSprite, unsigned char *pBitmap, unsigned char *pMask, int w, int h);
+int oledSpriteMoveCtx(oled_t *pOLED, int iSprite, int x, int y);
+int oledSpriteHideCtx(oled_t *pOLED, int iSprite);
+int oledSetDeferredCtx(oled_t *pOLED, int bDeferred);
+int oledFlushCtx(oled_t *pOLED);
+int oledSetAsyncCtx(oled_t *pOLED, int bAsync);
+int oledPresentCtx(oled_t *pOLED);
+int oledSetPixelCtx(oled_t *pOLED, int x, int y, unsigned char ucColor);
+int oledSetContrastCtx(oled_t *pOLED, unsigned char ucContrast);
+unsigned long oledSkippedCommandsCtx(oled_t *pOLED);
+int oledScrollStartCtx(oled_t *pOLED, int iDir, int iStartPage, int iEndPage, int iFrames, int iVertical);
+int oledScrollStopCtx(oled_t *pOLED);
+int oledSetScrollAreaCtx(oled_t *pOLED, int iTopRows, int iRows);
+int oledScrollPagesCtx(oled_t *pOLED, int iStartPage, int iEndPage, int iDx);
+int oledSetClipCtx(oled_t *pOLED, int x, int y, int w, int h);
+int oledResetClipCtx(oled_t *pOLED);
+int oledCircleCtx(oled_t *pOLED, int xc, int yc, int r, unsigned char color);
+int oledFilledCircleCtx(oled_t *pOLED, int xc, int yc, int r, unsigned char color);
+int oledSquareCtx(oled_t *pOLED, int x, int y, int size, unsigned char color);
+int oledFilledSquareCtx(oled_t *pOLED, int x, int y, int size, unsigned char color);
+int oledRectangleCtx(oled_t *pOLED, int x, int y, int width, int height, unsigned char color);
+int oledFilledRectangleCtx(oled_t *pOLED, int x, int y, int width, int height, unsigned char color);
+int oledEllipseCtx(oled_t *pOLED, int xc, int yc, int rx, int ry, unsigned char color);
+int oledFilledEllipseCtx(oled_t *pOLED, int xc, int yc, int rx, int ry, unsigned char color);
+int oledTriangleCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color);
+int oledFilledTriangleCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color);
+int oledLineCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, unsigned char color);
+int oledHLineCtx(oled_t *pOLED, int x, int y, int length, unsigned char color);
+int oledVLineCtx(oled_t *pOLED, int x, int y, int length, unsigned char color);
+int oledPolygonCtx(oled_t *pOLED, int *vx, int *vy, int vertices, unsigned char color);
+int oledFilledPolygonCtx(oled_t *pOLED, int *vx, int *vy, int vertices, unsigned char color);
+int oledSetFillRuleCtx(oled_t *pOLED, int iRule);
+int oledArcCtx(oled_t *pOLED, int xc, int yc, int r, float sa, float ea, unsigned char color);
+int oledFilledArcCtx(oled_t *pOLED, int xc, int yc, int r, float sa, float ea, unsigned char color);
+int oledBezierCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, int x2, int y2, int x3, int y3, unsigned char color);
+int oledQuadBezierCtx(oled_t *pOLED, int x0, int y0, int x1, int y1, int x2, int y2, unsigned char color);
+int oledParabolaCtx(oled_t *pOLED, int h, int k, float a, int xs, int xe, unsigned char color);
 #endif // SHAPES96_H
@@ -0,0 +1,1501 @@
+//
+// shapes96 tests, run against the mock transport (no hardware needed)
+// make test
+//
+// Copyright 2017 BitBank Software, Inc. All Rights Reserved.
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//    http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//====================================================================
+// The library is included rather than linked so the tests can compare
+// what the panel shows with the library's local copy of the display
+
+#include <stdio.h>
+#include <string.h>
+
+#include "shapes96.c"
+#include "oledmock.h"
+
+static int iFailures;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); iFailures++; } } while (0)
+
+// The pixel at (x,y) of the local copy of a display
+static int ctxPixel(oled_t *pOLED, int x, int y) {
+	return (pOLED->ucScreen[(y >> 3)*pOLED->iPitch + x] >> (y & 7)) & 1;
+}
+
+static int screenPixel(int x, int y) {
+	return ctxPixel(&oledDefault, x, y);
+}
+
+// Number of pixels a panel shows differently from the local copy
+static int ctxMismatches(OLEDMOCK *pMock, oled_t *pOLED) {
+	int x, y, iBad = 0;
+
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++)
+			iBad += oledMockPixel(pMock, OLED_128x64, x, y) != ctxPixel(pOLED, x, y);
+	return iBad;
+}
+
+static int panelMismatches(OLEDMOCK *pMock) {
+	return ctxMismatches(pMock, &oledDefault);
+}
+
+// Number of pixels of the local copy that differ from a filled rectangle
+// with corners (x0,y0) and (x1,y1) on a clear screen
+static int rectMismatches(int x0, int y0, int x1, int y1) {
+	int x, y, iBad = 0;
+
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++)
+			iBad += screenPixel(x, y) != (x >= x0 && x <= x1 && y >= y0 && y <= y1);
+	return iBad;
+}
+
+// Start the default display on a freshly reset mock
+static void mockInit(OLEDMOCK *pMock) {
+	oledMockReset(pMock);
+	oledSetTransport(oledMockTransfer, pMock);
+	CHECK(oledInit(0, 0x3c, OLED_128x64, 0, 0) == 0);
+}
+
+// Each update is one transaction, commands and data together
+static void testTransactions(void) {
+	OLEDMOCK mock;
+
+	mockInit(&mock);
+	CHECK(mock.iTransactions == 1);
+
+	oledMockClearStats(&mock);
+	oledFill(0xff);
+	CHECK(mock.iTransactions == 1);
+	CHECK(mock.lDataBytes == 1024);
+	CHECK(rectMismatches(0, 0, 127, 63) == 0);
+	CHECK(panelMismatches(&mock) == 0);
+
+	// Immediate pixels: one transaction per change, none if nothing changes
+	oledFill(0);
+	oledMockClearStats(&mock);
+	oledSetPixel(5, 9, 1);
+	CHECK(mock.iTransactions == 1);
+	oledSetPixel(5, 9, 1);
+	CHECK(mock.iTransactions == 1);
+	CHECK(rectMismatches(5, 9, 5, 9) == 0);
+	CHECK(panelMismatches(&mock) == 0);
+
+	// Deferred drawing sends nothing until the flush, which is one transaction
+	oledFill(0);
+	oledSetDeferred(1);
+	oledMockClearStats(&mock);
+	oledFilledRectangle(10, 10, 20, 10, 1);
+	oledSetPixel(100, 50, 1);
+	CHECK(mock.iTransactions == 0);
+	CHECK(oledFlush() == 0);
+	CHECK(mock.iTransactions == 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledMockClearStats(&mock);
+	CHECK(oledFlush() == 0);
+	CHECK(mock.iTransactions == 0);
+
+	// Leaving deferred mode sends what is pending
+	oledSetPixel(100, 50, 0);
+	oledSetDeferred(0);
+	CHECK(rectMismatches(10, 10, 29, 19) == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Flushes stream the dirty rectangle through a window in horizontal and
+// vertical addressing; the panel must end up the same in every mode
+static void testAddressing(int iMode) {
+	OLEDMOCK mock;
+
+	oledSetAddressingMode(iMode);
+	mockInit(&mock);
+	oledFill(0);
+	CHECK(panelMismatches(&mock) == 0);
+	oledSetDeferred(1);
+	oledFilledRectangle(10, 10, 20, 10, 1);
+	oledSetPixel(3, 60, 1);
+	oledSetPixel(120, 2, 1);
+	oledMockClearStats(&mock);
+	CHECK(oledFlush() == 0);
+	CHECK(mock.iTransactions == 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledFilledRectangle(10, 10, 20, 10, 0);
+	oledFilledRectangle(40, 30, 9, 20, 1);
+	CHECK(oledFlush() == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	oledSetDeferred(0);
+	oledSetPixel(64, 33, 1);
+	oledSetPixel(65, 33, 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+	oledSetAddressingMode(OLED_ADDR_PAGE);
+}
+
+// Number of pixels the panel shows differently from a saved frame
+static int frameMismatches(OLEDMOCK *pMock, unsigned char *pFrame) {
+	int x, y, iBad = 0;
+
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++)
+			iBad += oledMockPixel(pMock, OLED_128x64, x, y) != ((pFrame[(y >> 3)*128 + x] >> (y & 7)) & 1);
+	return iBad;
+}
+
+// The flush thread sends the presented frame while the next one is drawn
+static void testAsync(void) {
+	OLEDMOCK mock;
+	unsigned char ucFrame[1024];
+	int i;
+
+	mockInit(&mock);
+	oledFill(0);
+	CHECK(oledSetAsync(1) == 0);
+	for (i=0; i<20; i++) {
+		oledFilledRectangle(i*4, 8, 16, 16, 1);
+		memcpy(ucFrame, oledDefault.ucScreen, sizeof(ucFrame));
+		CHECK(oledPresent() == 0);
+		oledFilledRectangle(i*4, 8, 16, 16, 0); // drawing on while it is sent
+		oledWaitIdle(&oledDefault);
+		CHECK(frameMismatches(&mock, ucFrame) == 0);
+	}
+	oledFilledCircle(64, 40, 12, 1);
+	CHECK(oledFlush() == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	CHECK(oledSetAsync(0) == 0);
+	oledShutdown();
+}
+
+// Pseudo-random numbers 0..n-1, the same on every run
+static unsigned int uiSeed = 1;
+static int testRand(int n) {
+	uiSeed = uiSeed * 1103515245 + 12345;
+	return (int)((uiSeed >> 16) % n);
+}
+
+// Filled rectangles are exact at any page alignment, clipped at the edges
+// and sent as one transaction
+static void testFilledRect(void) {
+	OLEDMOCK mock;
+	int i, x, y, w, h, iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (i=0, iBad=0; i<500; i++) {
+		x = testRand(160) - 16;
+		y = testRand(96) - 16;
+		w = testRand(40) + 1;
+		h = testRand(40) + 1;
+		oledFill(0);
+		oledFilledRectangle(x, y, w, h, 1);
+		iBad += rectMismatches(x, y, x+w-1, y+h-1) != 0;
+	}
+	CHECK(iBad == 0);
+	oledFill(0);
+	oledFilledSquare(3, 5, 7, 1);
+	CHECK(rectMismatches(3, 5, 9, 11) == 0);
+	oledSetDeferred(0);
+
+	// Clearing a rectangle out of a full screen leaves only the rest
+	oledFill(0xff);
+	oledMockClearStats(&mock);
+	oledFilledRectangle(0, 0, 128, 13, 0);
+	oledFilledRectangle(0, 30, 128, 34, 0);
+	oledFilledRectangle(0, 13, 7, 17, 0);
+	oledFilledRectangle(19, 13, 109, 17, 0);
+	CHECK(mock.iTransactions == 4);
+	CHECK(rectMismatches(7, 13, 18, 29) == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Lines along the axes are exact and clipped; an outline rectangle is
+// exactly its border
+static void testHVLines(void) {
+	OLEDMOCK mock;
+	int i, x, y, n, iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (i=0, iBad=0; i<500; i++) {
+		x = testRand(160) - 16;
+		y = testRand(96) - 16;
+		n = testRand(60) + 1;
+		oledFill(0);
+		oledHLine(x, y, n, 1);
+		iBad += rectMismatches(x, y, x+n-1, y) != 0;
+		oledFill(0);
+		oledVLine(x, y, n, 1);
+		iBad += rectMismatches(x, y, x, y+n-1) != 0;
+	}
+	CHECK(iBad == 0);
+	oledFill(0);
+	oledRectangle(5, 6, 30, 20, 1);
+	for (y=0, iBad=0; y<64; y++)
+		for (x=0; x<128; x++)
+			iBad += screenPixel(x, y) != ((x == 5 || x == 34) && y >= 6 && y <= 25) + ((y == 6 || y == 25) && x > 5 && x < 34);
+	CHECK(iBad == 0);
+	oledSetDeferred(0);
+
+	oledMockClearStats(&mock);
+	oledHLine(0, 40, 128, 1);
+	oledVLine(64, 0, 64, 1);
+	CHECK(mock.iTransactions == 2);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Filled ellipses cover exactly the pixel centers inside
+// (dx/rx)^2 + (dy/ry)^2 <= 1, one transaction each
+static void testFilledEllipse(void) {
+	OLEDMOCK mock;
+	int i, x, y, xc, yc, rx, ry, iBad;
+	long long dx, dy;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (i=0, iBad=0; i<200; i++) {
+		xc = testRand(160) - 16;
+		yc = testRand(96) - 16;
+		rx = testRand(40);
+		ry = (i & 1) ? rx : testRand(40);
+		oledFill(0);
+		if (i & 1)
+			oledFilledCircle(xc, yc, rx, 1);
+		else
+			oledFilledEllipse(xc, yc, rx, ry, 1);
+		for (y=0; y<64; y++)
+			for (x=0; x<128; x++) {
+				dx = x - xc;
+				dy = y - yc;
+				iBad += screenPixel(x, y) != (dx*dx*ry*ry + dy*dy*rx*rx <= (long long)rx*rx*ry*ry && llabs(dx) <= rx && llabs(dy) <= ry);
+			}
+	}
+	CHECK(iBad == 0);
+	oledSetDeferred(0);
+	oledMockClearStats(&mock);
+	oledFilledEllipse(64, 32, 50, 20, 1);
+	CHECK(mock.iTransactions == 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// How many times each pixel was set over several drawings
+static unsigned char ucCount[64][128];
+
+static void countPixels(void) {
+	int x, y;
+
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++)
+			ucCount[y][x] += screenPixel(x, y);
+}
+
+// Draw one filled triangle of a mesh on a clear screen and count its pixels
+static void meshTriangle(int x0, int y0, int x1, int y1, int x2, int y2) {
+	oledFill(0);
+	if (testRand(2)) // either winding
+		oledFilledTriangle(x0, y0, x1, y1, x2, y2, 1);
+	else
+		oledFilledTriangle(x2, y2, x1, y1, x0, y0, 1);
+	countPixels();
+}
+
+// A mesh of triangles tiling a rectangle covers every pixel of it exactly
+// once (top-left rule), and no pixel outside it
+static void testTriangleMesh(void) {
+	OLEDMOCK mock;
+	int vx[9][9], vy[9][9];
+	int i, j, x, y, iBad, iTwice;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	memset(ucCount, 0, sizeof(ucCount));
+	for (j=0; j<9; j++)	// grid over (8,4)-(120,60), inner vertices jittered
+		for (i=0; i<9; i++) {
+			vx[j][i] = 8 + i*14 + ((i > 0 && i < 8) ? testRand(7) - 3 : 0);
+			vy[j][i] = 4 + j*7 + ((j > 0 && j < 8) ? testRand(5) - 2 : 0);
+		}
+	for (j=0; j<8; j++)
+		for (i=0; i<8; i++) {
+			if (testRand(2)) {
+				meshTriangle(vx[j][i], vy[j][i], vx[j][i+1], vy[j][i+1], vx[j+1][i+1], vy[j+1][i+1]);
+				meshTriangle(vx[j][i], vy[j][i], vx[j+1][i+1], vy[j+1][i+1], vx[j+1][i], vy[j+1][i]);
+			} else {
+				meshTriangle(vx[j][i], vy[j][i], vx[j][i+1], vy[j][i+1], vx[j+1][i], vy[j+1][i]);
+				meshTriangle(vx[j][i+1], vy[j][i+1], vx[j+1][i+1], vy[j+1][i+1], vx[j+1][i], vy[j+1][i]);
+			}
+		}
+	for (y=0, iBad=0, iTwice=0; y<64; y++)
+		for (x=0; x<128; x++) {
+			iBad += ucCount[y][x] != (x >= 8 && x < 120 && y >= 4 && y < 60);
+			iTwice += ucCount[y][x] > 1;
+		}
+	CHECK(iTwice == 0);
+	CHECK(iBad == 0);
+
+	// Degenerate triangles draw nothing
+	oledFill(0);
+	oledFilledTriangle(10, 10, 20, 20, 30, 30, 1);
+	oledFilledTriangle(10, 10, 10, 10, 10, 10, 1);
+	CHECK(rectMismatches(0, 0, -1, -1) == 0);
+	oledSetDeferred(0);
+
+	oledMockClearStats(&mock);
+	oledFilledTriangle(64, 2, 10, 60, 120, 50, 1);
+	CHECK(mock.iTransactions == 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Reference polygon fill: a pixel center is inside by the winding number
+// (or parity) of the edges crossing its scanline at or left of it
+static int polygonContains(int *vx, int *vy, int n, int iRule, int x, int y) {
+	int i, j, iWind = 0, iCross = 0;
+
+	for (i=0; i<n; i++) {
+		int xa = vx[i], ya = vy[i], xb = vx[(i+1) % n], yb = vy[(i+1) % n], w = 1;
+		if (ya == yb)
+			continue;
+		if (ya > yb) {
+			j = xa; xa = xb; xb = j;
+			j = ya; ya = yb; yb = j;
+			w = -1;
+		}
+		if (y < ya || y >= yb)
+			continue;
+		if ((long long)(y - ya) * (xb - xa) <= (long long)(x - xa) * (yb - ya)) {
+			iWind += w;
+			iCross++;
+		}
+	}
+	return (iRule == OLED_FILL_NONZERO) ? (iWind != 0) : (iCross & 1);
+}
+
+static int polygonMismatches(int *vx, int *vy, int n, int iRule) {
+	int x, y, iBad = 0;
+
+	oledFill(0);
+	oledSetFillRule(iRule);
+	oledFilledPolygon(vx, vy, n, 1);
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++)
+			iBad += screenPixel(x, y) != polygonContains(vx, vy, n, iRule, x, y);
+	return iBad;
+}
+
+// Polygon fill matches the reference for self-intersecting outlines under
+// both rules, and for outlines with hundreds of vertices
+static void testFilledPolygon(void) {
+	OLEDMOCK mock;
+	int vx[400], vy[400];
+	int i, n, iBad;
+	int sx[5] = {64, 82, 34, 94, 46}, sy[5] = {2, 60, 24, 24, 60}; // pentagram
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	CHECK(polygonMismatches(sx, sy, 5, OLED_FILL_EVENODD) == 0);
+	CHECK(screenPixel(64, 32) == 0); // the middle is a hole
+	CHECK(polygonMismatches(sx, sy, 5, OLED_FILL_NONZERO) == 0);
+	CHECK(screenPixel(64, 32) == 1);
+	for (i=0, iBad=0; i<100; i++) {
+		for (n=0; n<3 + (i % 12); n++) {
+			vx[n] = testRand(180) - 26;
+			vy[n] = testRand(100) - 18;
+		}
+		iBad += polygonMismatches(vx, vy, n, OLED_FILL_EVENODD);
+		iBad += polygonMismatches(vx, vy, n, OLED_FILL_NONZERO);
+	}
+	CHECK(iBad == 0);
+	for (n=0; n<400; n++) {	// a wobbly ring going round twice
+		vx[n] = 64 + (int)((24 + (n % 7)) * cos(n * 4 * M_PI / 400));
+		vy[n] = 32 + (int)((24 + (n % 5)) * sin(n * 4 * M_PI / 400));
+	}
+	CHECK(polygonMismatches(vx, vy, 400, OLED_FILL_EVENODD) == 0);
+	CHECK(polygonMismatches(vx, vy, 400, OLED_FILL_NONZERO) == 0);
+	oledSetFillRule(OLED_FILL_EVENODD);
+	oledSetDeferred(0);
+
+	oledMockClearStats(&mock);
+	oledFilledPolygon(sx, sy, 5, 1);
+	CHECK(mock.iTransactions == 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Number of pixels where the counted drawings don't cover the screen
+// exactly once, or cover it more than iMax times
+static int countMismatches(int iMax) {
+	int x, y, iBad = 0;
+
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++)
+			iBad += (ucCount[y][x] != 0) != screenPixel(x, y) || ucCount[y][x] > iMax;
+	return iBad;
+}
+
+// Arcs are the pixels of oledCircle() in their wedge, each drawn once:
+// arcs that join up to a full turn add up to the circle with no pixel in
+// two of them. The same goes for pie slices and oledFilledCircle().
+static void testArcs(void) {
+	OLEDMOCK mock;
+	int r, iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (r=0, iBad=0; r<30; r++) {
+		memset(ucCount, 0, sizeof(ucCount));
+		oledFill(0);
+		oledArc(64, 32, r, 10.0f, 100.0f, 1);
+		countPixels();
+		oledFill(0);
+		oledArc(64, 32, r, 100.0f, 250.0f, 1);
+		countPixels();
+		oledFill(0);
+		oledArc(64, 32, r, 250.0f, 370.0f, 1);
+		countPixels();
+		oledFill(0);
+		oledCircle(64, 32, r, 1);
+		iBad += countMismatches(r ? 1 : 3);
+		oledArc(64, 32, r, 0.0f, 360.0f, 0);
+		iBad += rectMismatches(0, 0, -1, -1) != 0;
+
+		memset(ucCount, 0, sizeof(ucCount));
+		oledFill(0);
+		oledFilledArc(64, 32, r, 10.0f, 100.0f, 1);
+		countPixels();
+		oledFill(0);
+		oledFilledArc(64, 32, r, 100.0f, 250.0f, 1);
+		countPixels();
+		oledFill(0);
+		oledFilledArc(64, 32, r, 250.0f, 370.0f, 1);
+		countPixels();
+		ucCount[32][64] = 1; // the center is in every slice
+		oledFill(0);
+		oledFilledCircle(64, 32, r, 1);
+		iBad += countMismatches(1);
+		oledFilledArc(64, 32, r, -90.0f, 270.0f, 0);
+		iBad += rectMismatches(0, 0, -1, -1) != 0;
+	}
+	CHECK(iBad == 0);
+
+	// A quarter arc: x and y both grow from the center, clockwise on screen
+	oledFill(0);
+	oledArc(64, 32, 20, 0.0f, 90.0f, 1);
+	CHECK(screenPixel(84, 32) == 1 && screenPixel(64, 52) == 1);
+	CHECK(screenPixel(44, 32) == 0 && screenPixel(64, 12) == 0);
+	oledSetDeferred(0);
+
+	oledMockClearStats(&mock);
+	oledFilledArc(64, 32, 30, 200.0f, 340.0f, 1);
+	oledArc(64, 32, 31, 200.0f, 340.0f, 1);
+	CHECK(mock.iTransactions == 2);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Checks of a drawn curve against points sampled along the true one:
+// every pixel set is near the curve, the curve has no gaps and the pixels
+// form one 8-connected run. Returns the number of failed checks.
+static int curveMismatches(float *fx, float *fy, int n) {
+	static unsigned char ucSeen[64][128];
+	int stack[8192], iTop = 0, iSet = 0, iReached = 0, iBad = 0;
+	int i, x, y, dx, dy;
+	float d, dMin;
+
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++) {
+			if (!screenPixel(x, y))
+				continue;
+			iSet++;
+			for (i=0, dMin=1e9f; i<n; i++) {
+				d = (fx[i]-x)*(fx[i]-x) + (fy[i]-y)*(fy[i]-y);
+				if (d < dMin) dMin = d;
+			}
+			iBad += dMin > 1.25f*1.25f; // a stray pixel
+		}
+	for (i=0; i<n; i++) {
+		for (y=0, dMin=1e9f; y<64; y++)
+			for (x=0; x<128; x++)
+				if (screenPixel(x, y)) {
+					d = (fx[i]-x)*(fx[i]-x) + (fy[i]-y)*(fy[i]-y);
+					if (d < dMin) dMin = d;
+				}
+		iBad += dMin > 1.5f*1.5f; // a gap
+	}
+	memset(ucSeen, 0, sizeof(ucSeen));
+	x = (int)lroundf(fx[0]);
+	y = (int)lroundf(fy[0]);
+	if (screenPixel(x, y)) {
+		ucSeen[y][x] = 1;
+		stack[iTop++] = y*128 + x;
+	}
+	while (iTop) {	// flood the 8-connected run from the first endpoint
+		i = stack[--iTop];
+		iReached++;
+		for (dy=-1; dy<=1; dy++)
+			for (dx=-1; dx<=1; dx++) {
+				x = (i & 127) + dx;
+				y = (i >> 7) + dy;
+				if (x >= 0 && x < 128 && y >= 0 && y < 64 && !ucSeen[y][x] && screenPixel(x, y)) {
+					ucSeen[y][x] = 1;
+					stack[iTop++] = y*128 + x;
+				}
+			}
+	}
+	return iBad + (iReached != iSet);
+}
+
+// Bezier curves start and end on their end points and stay within reach of
+// the true curve without gaps, whatever their length; so do parabolas
+static void testCurves(void) {
+	OLEDMOCK mock;
+	float fx[2001], fy[2001], t, u;
+	int i, j, p[8], iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (j=0, iBad=0; j<60; j++) {
+		for (i=0; i<8; i++) // on screen, the curve stays in their hull
+			p[i] = (i & 1) ? testRand(64) : testRand(128);
+		if (j & 1)
+			p[0] = p[6] ^ 1, p[1] = p[7]; // loops ending next to their start
+		oledFill(0);
+		if (j % 3) {
+			oledBezier(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], 1);
+			for (i=0; i<=2000; i++) {
+				t = i / 2000.0f; u = 1 - t;
+				fx[i] = u*u*u*p[0] + 3*u*u*t*p[2] + 3*u*t*t*p[4] + t*t*t*p[6];
+				fy[i] = u*u*u*p[1] + 3*u*u*t*p[3] + 3*u*t*t*p[5] + t*t*t*p[7];
+			}
+		} else {
+			oledQuadBezier(p[0], p[1], p[2], p[3], p[6], p[7], 1);
+			for (i=0; i<=2000; i++) {
+				t = i / 2000.0f; u = 1 - t;
+				fx[i] = u*u*p[0] + 2*u*t*p[2] + t*t*p[6];
+				fy[i] = u*u*p[1] + 2*u*t*p[3] + t*t*p[7];
+			}
+		}
+		iBad += !screenPixel(p[0], p[1]) || !screenPixel(p[6], p[7]);
+		iBad += curveMismatches(fx, fy, 2001) != 0;
+	}
+	CHECK(iBad == 0);
+
+	// y = k + a*(x-h)^2 rounded in every column
+	oledFill(0);
+	oledParabola(64, 4, 0.05f, 30, 98, 1);
+	for (i=30, iBad=0; i<=98; i++)
+		iBad += !screenPixel(i, 4 + (int)floorf(0.05f*(i-64)*(i-64) + 0.5f));
+	CHECK(iBad == 0);
+	for (i=0; i<=2000; i++) {
+		fx[i] = 30 + 68 * (i / 2000.0f);
+		fy[i] = 4 + 0.05f*(fx[i]-64)*(fx[i]-64);
+	}
+	CHECK(curveMismatches(fx, fy, 2001) == 0);
+	oledSetDeferred(0);
+
+	oledMockClearStats(&mock);
+	oledBezier(2, 60, 40, -30, 90, 90, 125, 3, 1);
+	CHECK(mock.iTransactions == 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Draw shape i of a set that exercises every primitive
+static void clipShape(int i, int x, int y) {
+	int vx[5] = {x, x+50, x+10, x+60, x+25}, vy[5] = {y, y+10, y+40, y+35, y-12};
+
+	switch (i) {
+		case 0: oledLine(x, y, x+90, y+37, 1); break;
+		case 1: oledLine(x+70, y-5, x-3, y+50, 1); break;
+		case 2: oledCircle(x+20, y+15, 25, 1); break;
+		case 3: oledFilledCircle(x+20, y+15, 25, 1); break;
+		case 4: oledEllipse(x+30, y+10, 40, 18, 1); break;
+		case 5: oledFilledEllipse(x+30, y+10, 40, 18, 1); break;
+		case 6: oledRectangle(x-5, y-5, 70, 40, 1); break;
+		case 7: oledFilledRectangle(x-5, y-5, 70, 40, 1); break;
+		case 8: oledTriangle(x, y, x+80, y+20, x+20, y+50, 1); break;
+		case 9: oledFilledTriangle(x, y, x+80, y+20, x+20, y+50, 1); break;
+		case 10: oledPolygon(vx, vy, 5, 1); break;
+		case 11: oledFilledPolygon(vx, vy, 5, 1); break;
+		case 12: oledArc(x+20, y+20, 30, 30.0f, 300.0f, 1); break;
+		case 13: oledFilledArc(x+20, y+20, 30, 30.0f, 300.0f, 1); break;
+		case 14: oledBezier(x, y, x+100, y-40, x-30, y+90, x+70, y+30, 1); break;
+		case 15: oledQuadBezier(x, y+40, x+40, y-60, x+90, y+30, 1); break;
+		case 16: oledParabola(x+30, y, 0.04f, x-20, x+80, 1); break;
+		case 17: oledHLine(x-10, y+7, 100, 1); oledVLine(x+13, y-10, 80, 1); break;
+		case 18: oledSetPixel(x+20, y+20, 1); oledSetPixel(x+21, y+30, 1); break;
+	}
+}
+
+// Clipped drawing is exactly the unclipped drawing inside the clip
+// rectangle, and nothing outside it
+static void testClip(void) {
+	OLEDMOCK mock;
+	unsigned char ucFull[1024];
+	int i, j, x, y, px, py, cx, cy, cw, ch, iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (j=0, iBad=0; j<40; j++) {
+		x = testRand(140) - 20;
+		y = testRand(80) - 20;
+		cx = testRand(100);
+		cy = testRand(50);
+		cw = testRand(60) + 1;
+		ch = testRand(40) + 1;
+		for (i=0; i<19; i++) {
+			oledResetClip();
+			oledFill(0);
+			clipShape(i, x, y);
+			memcpy(ucFull, oledDefault.ucScreen, sizeof(ucFull));
+			oledFill(0);
+			oledSetClip(cx, cy, cw, ch);
+			clipShape(i, x, y);
+			for (py=0; py<64; py++)
+				for (px=0; px<128; px++)
+					iBad += screenPixel(px, py) != (((ucFull[(py >> 3)*128 + px] >> (py & 7)) & 1) && px >= cx && px < cx+cw && py >= cy && py < cy+ch);
+		}
+	}
+	CHECK(iBad == 0);
+	oledResetClip();
+	oledSetDeferred(0);
+
+	oledFill(0);
+	oledSetClip(20, 10, 40, 30);
+	oledMockClearStats(&mock);
+	oledFilledCircle(40, 25, 30, 1);
+	CHECK(mock.iTransactions == 1);
+	CHECK(rectMismatches(20, 10, 59, 39) == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	oledResetClip();
+	oledShutdown();
+}
+
+// Contexts on different buses keep their own frame buffers and state
+static void testContexts(void) {
+	OLEDMOCK mock, mockA, mockB;
+	oled_t *pA, *pB;
+
+	mockInit(&mock);
+	oledFill(0);
+	oledMockReset(&mockA);
+	oledMockReset(&mockB);
+	pA = oledCreate();
+	pB = oledCreate();
+	CHECK(pA != NULL && pB != NULL);
+	oledSetTransportCtx(pA, oledMockTransfer, &mockA);
+	oledSetTransportCtx(pB, oledMockTransfer, &mockB);
+	oledSetAddressingModeCtx(pB, OLED_ADDR_HORIZONTAL);
+	CHECK(oledInitCtx(pA, 1, 0x3c, OLED_128x64, 0, 0) == 0);
+	CHECK(oledInitCtx(pB, 2, 0x3d, OLED_128x64, 0, 0) == 0);
+	oledFillCtx(pA, 0);
+	oledFillCtx(pB, 0);
+	oledSetDeferredCtx(pB, 1);
+	oledSetClipCtx(pA, 0, 0, 64, 64);
+
+	oledFilledCircleCtx(pA, 64, 32, 20, 1);
+	oledFilledTriangleCtx(pB, 0, 0, 127, 0, 64, 63, 1);
+	oledLine(0, 63, 127, 0, 1);
+	CHECK(mockB.iTransactions == 2); // deferred: only init and fill so far
+	CHECK(oledFlushCtx(pB) == 0);
+	CHECK(ctxMismatches(&mockA, pA) == 0);
+	CHECK(ctxMismatches(&mockB, pB) == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	CHECK(ctxPixel(pA, 70, 32) == 0); // pA's clip
+	CHECK(ctxPixel(pB, 64, 40) == 1 && screenPixel(64, 40) == 0);
+	oledDestroy(pA);
+	oledDestroy(pB);
+	oledShutdown();
+}
+
+// oledFlushMany() sends every display once, buses in parallel and shared
+// buses in turn, and reports a display it could not flush
+static void testFlushMany(void) {
+	OLEDMOCK mocks[6];
+	oled_t *pList[7];
+	int iChannel[6] = {1, 1, 2, 3, 4, 4};
+	int i, j, iBad;
+
+	for (i=0; i<6; i++) {
+		oledMockReset(&mocks[i]);
+		pList[i] = oledCreate();
+		oledSetTransportCtx(pList[i], oledMockTransfer, &mocks[i]);
+		CHECK(oledInitCtx(pList[i], iChannel[i], 0x3c + (i & 1), OLED_128x64, 0, 0) == 0);
+		oledFillCtx(pList[i], 0);
+		oledSetDeferredCtx(pList[i], 1);
+	}
+	pList[6] = oledCreate(); // never initialized
+	for (j=0, iBad=0; j<50; j++) {
+		for (i=0; i<6; i++) {
+			oledFillCtx(pList[i], (unsigned char)(j + 1)); // every byte changes
+			oledFilledCircleCtx(pList[i], (j*7 + i*20) & 127, 32, 10 + i, j & 1);
+			oledMockClearStats(&mocks[i]);
+		}
+		iBad += oledFlushMany(pList, 6) != 0;
+		for (i=0; i<6; i++)
+			iBad += mocks[i].iTransactions != 1 || ctxMismatches(&mocks[i], pList[i]) != 0;
+	}
+	CHECK(iBad == 0);
+	oledLineCtx(pList[2], 0, 0, 127, 63, 1);
+	CHECK(oledFlushMany(pList, 7) == -1);
+	CHECK(ctxMismatches(&mocks[2], pList[2]) == 0);
+	for (i=0; i<7; i++)
+		oledDestroy(pList[i]);
+}
+
+// A video wall: each panel shows its part of the canvas, drawn across
+// panel edges, and only panels with changes are sent
+static void testWall(void) {
+	OLEDMOCK mocks[4], one;
+	oled_t *pPanels[4], *pWall, *pList[2];
+	int i, x, y, iBad;
+
+	pWall = oledWallCreate(2, 2);
+	CHECK(pWall != NULL);
+	for (i=0; i<4; i++) {
+		oledMockReset(&mocks[i]);
+		pPanels[i] = oledCreate();
+		oledSetTransportCtx(pPanels[i], oledMockTransfer, &mocks[i]);
+		CHECK(oledInitCtx(pPanels[i], 1 + (i & 1), 0x3c + (i >> 1), OLED_128x64, 0, 0) == 0);
+		CHECK(oledWallAttach(pWall, i & 1, i >> 1, pPanels[i]) == 0);
+	}
+	CHECK(oledWallAttach(pWall, 2, 0, pPanels[0]) == -1);
+	oledSetDeferredCtx(pWall, 1);
+	oledFillCtx(pWall, 0);
+	oledFilledCircleCtx(pWall, 128, 64, 40, 1);
+	oledLineCtx(pWall, 0, 127, 255, 0, 0);
+	oledWriteStringCtx(pWall, 14, 7, "wall", FONT_NORMAL);
+	CHECK(oledFlushCtx(pWall) == 0);
+	for (i=0, iBad=0; i<4; i++)
+		for (y=0; y<64; y++)
+			for (x=0; x<128; x++)
+				iBad += oledMockPixel(&mocks[i], OLED_128x64, x, y) != ctxPixel(pWall, (i & 1)*128 + x, (i >> 1)*64 + y);
+	CHECK(iBad == 0);
+
+	// Immediate drawing in one corner sends to that panel only
+	oledSetDeferredCtx(pWall, 0);
+	for (i=0; i<4; i++)
+		oledMockClearStats(&mocks[i]);
+	oledFilledRectangleCtx(pWall, 200, 100, 20, 20, 1);
+	CHECK(mocks[0].iTransactions == 0 && mocks[1].iTransactions == 0 && mocks[2].iTransactions == 0);
+	CHECK(mocks[3].iTransactions == 1);
+	CHECK(ctxMismatches(&mocks[3], pPanels[3]) == 0);
+	CHECK(ctxPixel(pPanels[3], 80, 40) == 1);
+
+	// A wall can be flushed by oledFlushMany() with other displays
+	oledMockReset(&one);
+	pList[0] = oledCreate();
+	oledSetTransportCtx(pList[0], oledMockTransfer, &one);
+	CHECK(oledInitCtx(pList[0], 3, 0x3c, OLED_128x64, 0, 0) == 0);
+	pList[1] = pWall;
+	oledSetDeferredCtx(pWall, 1);
+	oledSetDeferredCtx(pList[0], 1);
+	oledFilledCircleCtx(pWall, 100, 70, 50, 0);
+	oledFilledCircleCtx(pList[0], 64, 32, 20, 1);
+	CHECK(oledFlushMany(pList, 2) == 0);
+	CHECK(ctxMismatches(&one, pList[0]) == 0);
+	for (i=0, iBad=0; i<4; i++)
+		iBad += ctxMismatches(&mocks[i], pPanels[i]);
+	CHECK(iBad == 0);
+	oledDestroy(pList[0]);
+	oledDestroy(pWall);
+	for (i=0; i<4; i++)
+		oledDestroy(pPanels[i]);
+}
+
+// The pixel at (x,y) of a saved 128x64 frame, 0 off its edges
+static int bufPixel(unsigned char *pBuf, int x, int y) {
+	if (x < 0 || x > 127 || y < 0 || y > 63)
+		return 0;
+	return (pBuf[(y >> 3)*128 + x] >> (y & 7)) & 1;
+}
+
+// Text drawn at any pixel position is the page-aligned text moved there,
+// combined with what is under it by the text mode
+static void testDrawString(void) {
+	OLEDMOCK mock;
+	unsigned char ucText[1024];
+	int iFont, w, dx, dy, x, y, iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (iFont=FONT_NORMAL, iBad=0; iFont<=FONT_SMALL; iFont++) {
+		if (iFont == FONT_BIG)
+			continue;
+		w = (iFont == FONT_SMALL) ? 6 : 8;
+		oledFill(0);
+		oledWriteString(2, 3, "Hi, 42!", iFont);
+		memcpy(ucText, oledDefault.ucScreen, sizeof(ucText));
+		for (dy=-9; dy<=9; dy++)
+			for (dx=-4; dx<=4; dx++) {
+				oledFill(0);
+				oledFilledRectangle(20, 20, 30, 12, 1);
+				oledDrawString(2*w + dx, 24 + dy, "Hi, 42!", iFont, OLED_TEXT_TRANSPARENT);
+				for (y=0; y<64; y++)
+					for (x=0; x<128; x++)
+						iBad += screenPixel(x, y) != (bufPixel(ucText, x - dx, y - dy) | (x >= 20 && x < 50 && y >= 20 && y < 32));
+				oledFill(0);
+				oledFilledRectangle(20, 20, 30, 12, 1);
+				oledDrawString(2*w + dx, 24 + dy, "Hi, 42!", iFont, OLED_TEXT_XOR);
+				for (y=0; y<64; y++)
+					for (x=0; x<128; x++)
+						iBad += screenPixel(x, y) != (bufPixel(ucText, x - dx, y - dy) ^ (x >= 20 && x < 50 && y >= 20 && y < 32));
+				oledFill(0xff);
+				oledDrawString(2*w + dx, 24 + dy, "Hi, 42!", iFont, OLED_TEXT_OPAQUE);
+				for (y=0; y<64; y++)
+					for (x=0; x<128; x++)
+						iBad += screenPixel(x, y) != ((x >= 2*w + dx && x < 9*w + dx && y >= 24 + dy && y < 32 + dy) ? bufPixel(ucText, x - dx, y - dy) : 1);
+			}
+	}
+	CHECK(iBad == 0);
+	oledSetDeferred(0);
+
+	oledFill(0);
+	oledMockClearStats(&mock);
+	oledDrawString(5, 21, "Text", FONT_NORMAL, OLED_TEXT_TRANSPARENT);
+	CHECK(mock.iTransactions == 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Page-aligned text: FONT_BIG is all four pages of its 16x32 glyphs, the
+// same pixels as oledDrawString(), and each page row is one data burst
+static void testWriteString(void) {
+	OLEDMOCK mock;
+	unsigned char ucText[1024];
+	int x, y, iBad, iInk;
+
+	mockInit(&mock);
+	oledFill(0);
+	oledMockClearStats(&mock);
+	oledWriteString(1, 2, "Wgjy|", FONT_BIG);
+	CHECK(mock.iTransactions == 1);
+	CHECK(mock.iMessages <= 8);
+	CHECK(mock.lDataBytes == 4*5*16);
+	CHECK(panelMismatches(&mock) == 0);
+	memcpy(ucText, oledDefault.ucScreen, sizeof(ucText));
+	for (x=0, iInk=0; x<128; x++)
+		iInk += oledDefault.ucScreen[5*128 + x] != 0;
+	CHECK(iInk > 0); // the bottom page of the glyphs
+	oledSetDeferred(1);
+	oledFill(0);
+	oledDrawString(16, 16, "Wgjy|", FONT_BIG, OLED_TEXT_OPAQUE);
+	for (y=0, iBad=0; y<64; y++)
+		for (x=0; x<128; x++)
+			iBad += screenPixel(x, y) != bufPixel(ucText, x, y);
+	CHECK(iBad == 0);
+	oledSetDeferred(0);
+
+	oledMockClearStats(&mock);
+	oledWriteString(0, 7, "0123456789abcdef", FONT_NORMAL);
+	CHECK(mock.iTransactions == 1);
+	CHECK(mock.iMessages <= 2);
+	CHECK(mock.lDataBytes == 128);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Blits of both bitmap layouts at any position, with every raster op and
+// clipped, match a pixel by pixel reference
+static void testBlit(void) {
+	OLEDMOCK mock;
+	unsigned char ucBack[1024], ucBitmap[80*8];
+	int i, j, x, y, w, h, px, py, b, p, iRop, bRows, cx, cy, cw, ch, iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (i=0; i<1024; i++)
+		ucBack[i] = (unsigned char)testRand(256);
+	for (j=0, iBad=0; j<400; j++) {
+		w = testRand(70) + 1;
+		h = testRand(40) + 1;
+		x = testRand(150) - 20;
+		y = testRand(90) - 20;
+		iRop = testRand(5);
+		bRows = j & 1;
+		for (i=0; i<(int)sizeof(ucBitmap); i++)
+			ucBitmap[i] = (unsigned char)testRand(256);
+		cx = 0, cy = 0, cw = 128, ch = 64;
+		if (j & 2) {
+			cx = testRand(100), cy = testRand(50), cw = testRand(60) + 1, ch = testRand(40) + 1;
+		}
+		oledResetClip();
+		for (py=0; py<64; py++)
+			for (px=0; px<128; px++)
+				oledSetPixel(px, py, bufPixel(ucBack, px, py));
+		oledSetClip(cx, cy, cw, ch);
+		if (bRows)
+			oledBlitRows(x, y, ucBitmap, w, h, iRop);
+		else
+			oledBlit(x, y, ucBitmap, w, h, iRop);
+		for (py=0; py<64; py++)
+			for (px=0; px<128; px++) {
+				p = bufPixel(ucBack, px, py);
+				if (px >= x && px < x+w && py >= y && py < y+h && px >= cx && px < cx+cw && py >= cy && py < cy+ch) {
+					if (bRows)
+						b = (ucBitmap[(py-y)*((w+7)/8) + ((px-x) >> 3)] >> (7 - ((px-x) & 7))) & 1;
+					else
+						b = (ucBitmap[((py-y) >> 3)*w + px-x] >> ((py-y) & 7)) & 1;
+					switch (iRop) {
+						case OLED_ROP_COPY: p = b; break;
+						case OLED_ROP_OR: p |= b; break;
+						case OLED_ROP_AND: p &= b; break;
+						case OLED_ROP_XOR: p ^= b; break;
+						case OLED_ROP_NOT: p = !b; break;
+					}
+				}
+				iBad += screenPixel(px, py) != p;
+			}
+	}
+	CHECK(iBad == 0);
+	oledResetClip();
+	CHECK(oledBlit(0, 0, ucBitmap, 8, 8, OLED_ROP_NOT + 1) == -1);
+	oledSetDeferred(0);
+
+	oledMockClearStats(&mock);
+	oledBlitRows(30, 13, ucBitmap, 45, 30, OLED_ROP_XOR);
+	CHECK(mock.iTransactions == 1);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// Sprites over a background: after any sequence of sets, moves and hides
+// the screen is the background with the visible sprites drawn over it in
+// index order, and hiding them all gives the background back
+static void testSprites(void) {
+	OLEDMOCK mock;
+	unsigned char ucBack[1024], ucImage[8][128], ucMask[8][128];
+	int sx[8], sy[8], sw[8], sh[8], bShown[8], bMasked[8];
+	int i, j, k, x, y, p, iBad, iBadPanel;
+
+	mockInit(&mock);
+	for (i=0; i<1024; i++)
+		ucBack[i] = (unsigned char)testRand(256);
+	oledSetDeferred(1);
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++)
+			oledSetPixel(x, y, bufPixel(ucBack, x, y));
+	oledSetDeferred(0);
+	memset(bShown, 0, sizeof(bShown));
+	memset(sw, 0, sizeof(sw));
+	oledSetClip(40, 20, 10, 10); // sprites ignore it
+	for (j=0, iBad=0, iBadPanel=0; j<600; j++) {
+		k = testRand(8);
+		i = testRand(10);
+		if (sw[k] == 0 || i == 0) {	// new bitmap
+			sw[k] = testRand(32) + 1;
+			sh[k] = testRand(32) + 1;
+			bMasked[k] = testRand(4) != 0;
+			for (i=0; i<128; i++) {
+				ucImage[k][i] = (unsigned char)testRand(256);
+				ucMask[k][i] = (unsigned char)testRand(256);
+			}
+			CHECK(oledSpriteSet(k, ucImage[k], bMasked[k] ? ucMask[k] : NULL, sw[k], sh[k]) == 0);
+		} else if (i == 1) {
+			CHECK(oledSpriteHide(k) == 0);
+			bShown[k] = 0;
+		} else {
+			sx[k] = testRand(150) - 24;
+			sy[k] = testRand(90) - 24;
+			oledMockClearStats(&mock);
+			CHECK(oledSpriteMove(k, sx[k], sy[k]) == 0);
+			CHECK(mock.iTransactions <= 1);
+			bShown[k] = 1;
+		}
+		for (y=0; y<64; y++)
+			for (x=0; x<128; x++) {
+				p = bufPixel(ucBack, x, y);
+				for (i=0; i<8; i++) {
+					int bx = x - sx[i], by = y - sy[i], o;
+					if (!bShown[i] || bx < 0 || bx >= sw[i] || by < 0 || by >= sh[i])
+						continue;
+					o = (by >> 3)*sw[i] + bx;
+					if (!bMasked[i] || ((ucMask[i][o] >> (by & 7)) & 1))
+						p = (ucImage[i][o] >> (by & 7)) & 1;
+				}
+				iBad += screenPixel(x, y) != p;
+			}
+		iBadPanel += panelMismatches(&mock);
+	}
+	CHECK(iBad == 0);
+	CHECK(iBadPanel == 0);
+	for (k=0; k<8; k++)
+		oledSpriteHide(k);
+	for (y=0, iBad=0; y<64; y++)
+		for (x=0; x<128; x++)
+			iBad += screenPixel(x, y) != bufPixel(ucBack, x, y);
+	CHECK(iBad == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	CHECK(oledSpriteMove(0, 0, 0) == 0 && oledSpriteSet(8, ucImage[0], NULL, 8, 8) == -1);
+	CHECK(oledSpriteSet(0, ucImage[0], NULL, 33, 8) == -1);
+	oledResetClip();
+	oledShutdown();
+}
+
+// oledScrollPages() moves a page range of the local copy and the panel
+// with it; stopping a hardware scroll puts back the pages it moved
+static void testScroll(void) {
+	OLEDMOCK mock;
+	unsigned char ucBack[1024], ucMoved[1024];
+	int i, j, dx, x, y, iBad;
+
+	mockInit(&mock);
+	for (i=0; i<1024; i++)
+		ucBack[i] = (unsigned char)testRand(256);
+	oledSetDeferred(1);
+	for (y=0; y<64; y++)
+		for (x=0; x<128; x++)
+			oledSetPixel(x, y, bufPixel(ucBack, x, y));
+	oledSetDeferred(0);
+	for (j=0, iBad=0; j<20; j++) {
+		dx = (testRand(40) + 1) * ((j & 1) ? -1 : 1); // keeps most of the pattern
+		oledMockClearStats(&mock);
+		CHECK(oledScrollPages(2, 4, dx) == 0);
+		CHECK(mock.iTransactions == 1);
+		iBad += panelMismatches(&mock);
+		for (i=2*128; i<5*128; i++) {	// the reference moves the same pages
+			x = (i & 127) - dx;
+			ucMoved[i] = (x >= 0 && x < 128) ? ucBack[(i & ~127) + x] : 0;
+		}
+		memcpy(&ucBack[2*128], &ucMoved[2*128], 3*128);
+		for (y=0; y<64; y++)
+			for (x=0; x<128; x++)
+				iBad += screenPixel(x, y) != bufPixel(ucBack, x, y);
+	}
+	CHECK(oledScrollPages(3, 3, -200) == 0);
+	for (x=0; x<128; x++)
+		iBad += oledDefault.ucScreen[3*128 + x] != 0; // scrolled out entirely
+	CHECK(iBad == 0);
+
+	for (i=OLED_SCROLL_RIGHT, iBad=0; i<=OLED_SCROLL_DIAG_LEFT; i++) {
+		CHECK(oledScrollStart(i, 1, 6, 5, 7) == 0);
+		CHECK(mock.bScrolling);
+		mock.iScrollSteps = 37; // the display moved its memory meanwhile
+		CHECK(oledScrollStop() == 0);
+		CHECK(!mock.bScrolling);
+		iBad += panelMismatches(&mock);
+	}
+	CHECK(iBad == 0);
+	CHECK(oledScrollStart(OLED_SCROLL_LEFT, 5, 4, 5, 0) == -1);
+	CHECK(oledScrollStart(OLED_SCROLL_LEFT, 0, 8, 5, 0) == -1);
+	CHECK(oledSetScrollArea(0, 64) == 0 && oledSetScrollArea(8, 57) == -1);
+	oledShutdown();
+}
+
+// Console lines past the bottom move the start line instead of the
+// screen; the panel then shows the last lines like a freshly drawn screen
+static void testConsole(void) {
+	OLEDMOCK mock, ref;
+	oled_t *pRef;
+	char szLine[16];
+	int i;
+
+	mockInit(&mock);
+	oledConsoleClear(FONT_NORMAL);
+	for (i=0; i<12; i++) {
+		sprintf(szLine, "line %d\n", i);
+		oledMockClearStats(&mock);
+		CHECK(oledConsolePuts(szLine) == 0);
+		CHECK(mock.iTransactions == 1);
+		if (i >= 8) // scrolled: the line and the cleared bottom page only
+			CHECK(mock.lDataBytes <= 2*128);
+	}
+	CHECK(mock.iStartLine != 0);
+	CHECK(panelMismatches(&mock) == 0);
+
+	oledMockReset(&ref);
+	pRef = oledCreate();
+	oledSetTransportCtx(pRef, oledMockTransfer, &ref);
+	CHECK(oledInitCtx(pRef, 1, 0x3c, OLED_128x64, 0, 0) == 0);
+	oledFillCtx(pRef, 0);
+	for (i=0; i<7; i++) {
+		sprintf(szLine, "line %d", i + 5);
+		oledWriteStringCtx(pRef, 0, i, szLine, FONT_NORMAL);
+	}
+	CHECK(ctxMismatches(&mock, pRef) == 0);
+	oledDestroy(pRef);
+	oledShutdown();
+}
+
+// Redrawing a frame sends only what changed since the last flush
+static void testDiffFlush(void) {
+	OLEDMOCK mock;
+	int i, iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	for (i=0, iBad=0; i<40; i++) {
+		oledFill(0);
+		oledRectangle(10 + i, 20, 30, 20, 1);
+		oledWriteString(0, 0, "Gauge", FONT_NORMAL);
+		oledMockClearStats(&mock);
+		CHECK(oledFlush() == 0);
+		if (i > 0)	// the rectangle moved by one pixel
+			iBad += mock.lDataBytes == 0 || mock.lDataBytes >= 64;
+		iBad += panelMismatches(&mock);
+	}
+	CHECK(iBad == 0);
+	oledFill(0);
+	oledRectangle(49, 20, 30, 20, 1);
+	oledWriteString(0, 0, "Gauge", FONT_NORMAL);
+	oledMockClearStats(&mock);
+	CHECK(oledFlush() == 0);
+	CHECK(mock.lDataBytes == 0); // the same frame again
+	oledShutdown();
+}
+
+// In page mode the write pointer is tracked, so pixels written one after
+// another along a page need no new position
+static void testSkippedCommands(void) {
+	OLEDMOCK mock;
+	unsigned long ulSkipped;
+	int x, iBad;
+
+	mockInit(&mock);
+	CHECK(oledSetAddressingMode(OLED_ADDR_PAGE) == 0);
+	oledFill(0);
+	oledMockClearStats(&mock);
+	ulSkipped = oledSkippedCommands();
+	for (x=10; x<110; x++)
+		oledSetPixel(x, 21, 1);
+	CHECK(mock.lCmdBytes == 3);
+	CHECK(oledSkippedCommands() - ulSkipped == 99*3);
+	CHECK(panelMismatches(&mock) == 0);
+	// a lost write leaves the pointer unknown, so the next one positions
+	mock.iFail = 1;
+	oledSetPixel(110, 21, 1);
+	for (x=111; x<120; x++)
+		oledSetPixel(x, 21, 1);
+	for (x=111, iBad=0; x<120; x++)
+		iBad += oledMockPixel(&mock, OLED_128x64, x, 21) != 1;
+	CHECK(iBad == 0);
+	oledShutdown();
+}
+
+// A frame lost on the bus is repaired by the next flush, with nothing
+// drawn again: on its own, in immediate mode, with the flush thread, and
+// for walls and displays flushed by oledFlushMany()
+static void testFailure(void) {
+	OLEDMOCK mock, mocks[2], one;
+	oled_t *pPanels[2], *pList[2];
+	int i, iBad;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	oledFill(0);
+	CHECK(oledFlush() == 0);
+	oledFilledRectangle(40, 20, 21, 21, 1);
+	mock.iFail = 1;
+	CHECK(oledFlush() != 0);
+	CHECK(panelMismatches(&mock) != 0);
+	CHECK(oledFlush() == 0);
+	CHECK(rectMismatches(40, 20, 60, 40) == 0);
+	CHECK(panelMismatches(&mock) == 0);
+
+	oledSetDeferred(0);
+	mock.iFail = 1;
+	oledLine(0, 0, 127, 63, 1);
+	CHECK(panelMismatches(&mock) != 0);
+	CHECK(oledFlush() == 0);
+	CHECK(panelMismatches(&mock) == 0);
+
+	CHECK(oledSetAsync(1) == 0);
+	oledFilledCircle(64, 32, 20, 0);
+	mock.iFail = 1;
+	oledPresent();
+	oledWaitIdle(&oledDefault);
+	CHECK(oledPresent() != 0);
+	oledWaitIdle(&oledDefault);
+	CHECK(panelMismatches(&mock) == 0);
+	CHECK(oledSetAsync(0) == 0);
+	oledShutdown();
+
+	pList[0] = oledWallCreate(2, 1);
+	for (i=0; i<2; i++) {
+		oledMockReset(&mocks[i]);
+		pPanels[i] = oledCreate();
+		oledSetTransportCtx(pPanels[i], oledMockTransfer, &mocks[i]);
+		CHECK(oledInitCtx(pPanels[i], 1 + i, 0x3c, OLED_128x64, 0, 0) == 0);
+		CHECK(oledWallAttach(pList[0], i, 0, pPanels[i]) == 0);
+	}
+	oledMockReset(&one);
+	pList[1] = oledCreate();
+	oledSetTransportCtx(pList[1], oledMockTransfer, &one);
+	CHECK(oledInitCtx(pList[1], 3, 0x3c, OLED_128x64, 0, 0) == 0);
+	for (i=0; i<2; i++) {
+		oledSetDeferredCtx(pList[i], 1);
+		oledFillCtx(pList[i], 0);
+	}
+	CHECK(oledFlushMany(pList, 2) == 0);
+	oledFilledCircleCtx(pList[0], 128, 32, 30, 1);
+	oledFilledCircleCtx(pList[1], 64, 32, 30, 1);
+	mocks[1].iFail = one.iFail = 1;
+	CHECK(oledFlushMany(pList, 2) != 0);
+	CHECK(oledFlushMany(pList, 2) == 0);
+	iBad = ctxMismatches(&one, pList[1]);
+	for (i=0; i<2; i++)
+		iBad += ctxMismatches(&mocks[i], pPanels[i]);
+	CHECK(iBad == 0);
+	for (i=0; i<2; i++) {
+		oledDestroy(pList[i]);
+		oledDestroy(pPanels[i]);
+	}
+}
+
+// Deferred text stays in the local copy, also while the flush thread
+// may be sending the previous frame
+static void testDeferredText(void) {
+	OLEDMOCK mock;
+	char szLine[16];
+	int i;
+
+	mockInit(&mock);
+	oledSetDeferred(1);
+	oledFill(0);
+	oledMockClearStats(&mock);
+	CHECK(oledWriteString(0, 2, "no traffic", FONT_NORMAL) == 0);
+	CHECK(mock.iTransactions == 0);
+	CHECK(oledSetAsync(1) == 0);
+	for (i=0; i<50; i++) {
+		sprintf(szLine, "frame %d", i);
+		CHECK(oledWriteString(0, i & 7, szLine, FONT_NORMAL) == 0);
+		oledPresent();
+	}
+	CHECK(oledFlush() == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	CHECK(oledSetAsync(0) == 0);
+	oledShutdown();
+}
+
+// Scroll commands wait for the flush thread, and stopping a scroll
+// restores the presented frame, not the one being drawn
+static void testAsyncScroll(void) {
+	OLEDMOCK mock;
+	unsigned char ucFrame[1024];
+	int i, iBad;
+
+	mockInit(&mock);
+	oledFill(0);
+	CHECK(oledSetAsync(1) == 0);
+	for (i=0, iBad=0; i<20; i++) {
+		oledFilledCircle(20 + i*4, 32, 15, i & 1);
+		memcpy(ucFrame, oledDefault.ucScreen, sizeof(ucFrame));
+		CHECK(oledPresent() == 0);
+		CHECK(oledScrollStart(OLED_SCROLL_LEFT, 0, 7, 0, 0) == 0);
+		oledFill(0xaa); // the next frame, not shown yet
+		mock.iScrollSteps = 9;
+		CHECK(oledScrollStop() == 0);
+		oledWaitIdle(&oledDefault);
+		iBad += frameMismatches(&mock, ucFrame);
+		memcpy(oledDefault.ucScreen, ucFrame, sizeof(ucFrame));
+	}
+	CHECK(iBad == 0);
+	CHECK(oledSetAsync(0) == 0);
+	oledShutdown();
+}
+
+// Small panels: every pixel of the local copy reaches a visible row
+static void testSmallPanels(void) {
+	OLEDMOCK mock;
+	int iTypes[2] = {OLED_128x32, OLED_64x32};
+	int i, j, x, y, iBad;
+
+	for (i=0; i<2; i++) {
+		oledMockReset(&mock);
+		oledSetTransport(oledMockTransfer, &mock);
+		CHECK(oledInit(0, 0x3c, iTypes[i], 0, 0) == 0);
+		oledSetDeferred(1);
+		oledFill(0);
+		for (j=0; j<8; j++)
+			oledLine(testRand(128), testRand(64), testRand(128), testRand(64), 1);
+		CHECK(oledFlush() == 0);
+		for (y=0, iBad=0; y<32; y++)
+			for (x=0; x<(i ? 64 : 128); x++)
+				iBad += oledMockPixel(&mock, iTypes[i], x, y) != screenPixel(x, y);
+		CHECK(iBad == 0);
+		oledShutdown();
+	}
+}
+
+// A console scroll lost on the bus is made good by the next line:
+// the start line and the lost changes are sent again
+static void testConsoleFailure(void) {
+	OLEDMOCK mock;
+	int i;
+
+	mockInit(&mock);
+	oledConsoleClear(FONT_NORMAL);
+	for (i=0; i<8; i++)
+		CHECK(oledConsolePuts("filler\n") == 0);
+	mock.iFail = 1;
+	CHECK(oledConsolePuts("lost\n") != 0);
+	CHECK(mock.iStartLine != oledDefault.iStartPage * 8);
+	CHECK(oledConsolePuts("next") == 0);
+	CHECK(mock.iStartLine == oledDefault.iStartPage * 8);
+	CHECK(panelMismatches(&mock) == 0); // and the pages the lost line changed
+	oledShutdown();
+}
+
+// Changing the addressing mode waits for the frame being sent in the
+// old one
+static void testAsyncAddressing(void) {
+	OLEDMOCK mock;
+	unsigned char ucFrame[1024];
+	int i, iBad;
+
+	mockInit(&mock);
+	oledFill(0);
+	CHECK(oledSetAsync(1) == 0);
+	for (i=0, iBad=0; i<60; i++) {
+		oledFill((unsigned char)(i * 37));
+		oledFilledCircle(i*2, 32, 20, i & 1);
+		memcpy(ucFrame, oledDefault.ucScreen, sizeof(ucFrame));
+		oledPresent();
+		CHECK(oledSetAddressingMode(i % 3) == 0);
+		oledWaitIdle(&oledDefault);
+		iBad += frameMismatches(&mock, ucFrame);
+	}
+	CHECK(iBad == 0);
+	CHECK(oledSetAsync(0) == 0);
+	oledShutdown();
+}
+
+// Stopping the flush thread returns to the drawing mode it started in
+static void testAsyncStop(void) {
+	OLEDMOCK mock;
+
+	mockInit(&mock);
+	oledFill(0);
+	CHECK(oledSetAsync(1) == 0);
+	CHECK(oledDefault.bDeferred);
+	oledFilledRectangle(10, 10, 20, 20, 1); // never presented
+	CHECK(oledSetAsync(0) == 0);
+	CHECK(!oledDefault.bDeferred);
+	CHECK(panelMismatches(&mock) == 0);
+	oledMockClearStats(&mock);
+	oledLine(0, 63, 127, 0, 1);
+	CHECK(mock.iTransactions == 1);
+
+	oledSetDeferred(1);
+	CHECK(oledSetAsync(1) == 0);
+	CHECK(oledSetAsync(0) == 0);
+	CHECK(oledDefault.bDeferred);
+	oledShutdown();
+}
+
+// Nothing is written to display memory while it scrolls; stopping the
+// scroll sends what was drawn meanwhile
+static void testDrawWhileScrolling(void) {
+	OLEDMOCK mock;
+	int i;
+
+	mockInit(&mock);
+	oledFill(0);
+	oledWriteString(0, 0, "scroll", FONT_NORMAL);
+	for (i=0; i<3; i++) {
+		oledMockClearStats(&mock);
+		if (i == 1)
+			oledSetDeferred(1);
+		else if (i == 2)
+			CHECK(oledSetAsync(1) == 0);
+		CHECK(oledScrollStart(OLED_SCROLL_RIGHT, 0, 3, 5, 0) == 0);
+		oledSetPixel(100, 50, i & 1);
+		oledFilledCircle(64, 32, 12, (i & 1) ^ 1);
+		oledWriteString(2, 2, "held", FONT_SMALL);
+		oledDrawString(3, 40, "back", FONT_NORMAL, OLED_TEXT_XOR);
+		CHECK(oledFlush() == 0);
+		oledPresent();
+		oledWaitIdle(&oledDefault);
+		CHECK(mock.lScrollData == 0);
+		mock.iScrollSteps = 20;
+		CHECK(oledScrollStop() == 0);
+		CHECK(panelMismatches(&mock) == 0);
+	}
+	CHECK(oledSetAsync(0) == 0);
+	// a deferred frame is still only sent by oledFlush()
+	CHECK(oledScrollStart(OLED_SCROLL_RIGHT, 0, 3, 5, 0) == 0);
+	oledSetPixel(100, 50, !screenPixel(100, 50));
+	CHECK(oledScrollStop() == 0);
+	CHECK(oledMockPixel(&mock, OLED_128x64, 100, 50) != screenPixel(100, 50));
+	CHECK(oledFlush() == 0);
+	CHECK(panelMismatches(&mock) == 0);
+	oledShutdown();
+}
+
+// oledWriteString() leaves out what lies outside the clip rectangle
+static void testClipText(void) {
+	OLEDMOCK mock;
+	unsigned char ucBack[1024];
+	int i, x, y, iBad;
+
+	mockInit(&mock);
+	for (i=0, iBad=0; i<3; i++) {
+		oledResetClip();
+		oledFill(0x55);
+		oledWriteString(1, 2, "Clipped text", i);
+		memcpy(ucBack, oledDefault.ucScreen, sizeof(ucBack));
+		oledFill(0x55);
+		oledSetClip(13, 19, 70, 30);
+		oledWriteString(1, 2, "Clipped text", i);
+		for (y=0; y<64; y++)
+			for (x=0; x<128; x++)
+				iBad += screenPixel(x, y) != ((x >= 13 && x < 83 && y >= 19 && y < 49) ? bufPixel(ucBack, x, y) : !(y & 1));
+		iBad += panelMismatches(&mock);
+	}
+	CHECK(iBad == 0);
+	oledResetClip();
+	oledShutdown();
+}
+
+int main(int argc, char *argv[]) {
+	testTransactions();
+	testAddressing(OLED_ADDR_PAGE);
+	testAddressing(OLED_ADDR_HORIZONTAL);
+	testAddressing(OLED_ADDR_VERTICAL);
+	testAsync();
+	testFilledRect();
+	testHVLines();
+	testFilledEllipse();
+	testTriangleMesh();
+	testFilledPolygon();
+	testArcs();
+	testCurves();
+	testClip();
+	testContexts();
+	testFlushMany();
+	testWall();
+	testDrawString();
+	testWriteString();
+	testBlit();
+	testSprites();
+	testScroll();
+	testConsole();
+	testDiffFlush();
+	testSkippedCommands();
+	testFailure();
+	testDeferredText();
+	testAsyncScroll();
+	testSmallPanels();
+	testConsoleFailure();
+	testAsyncAddressing();
+	testAsyncStop();
+	testDrawWhileScrolling();
+	testClipText();
+	if (iFailures) {
+		printf("%d check(s) failed\n", iFailures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}